@@ -51,7 +51,7 @@
           llvmPackages.llvm # macOS llvm-otool and llvm-install-name-tool
         ]
         ++ lib.optionals isLinux [
-          patchelf          # Linux RUNPATH updates
+          patchelf          # Linux RUNPATH fallback
           pkgsCross.mingwW64.buildPackages.binutils # x86_64-w64-mingw32-objdump
         ];
            
@@ -95,7 +95,7 @@
               "${pkgs.findutils}/bin"              # find
             ]
             ++ lib.optionals isLinux [
-              "${pkgs.patchelf}/bin"               # patchelf
+              "${pkgs.patchelf}/bin"               # patchelf (RUNPATH fallback)
               "${pkgs.pkgsCross.mingwW64.buildPackages.binutils}/bin" # x86_64-w64-mingw32-objdump
             ]);
           in
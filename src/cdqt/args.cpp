@@ -1,5 +1,6 @@
 #include "args.h"
 
+#include <charconv>
 #include <iostream>
 #include <string>
 #include <string_view>
@@ -11,7 +12,9 @@ namespace cdqt {
 void printUsage(const char* argv0) {
     std::cerr << "Usage: " << argv0
               << " --bin <path-to-binary> --out <output-dir> [--qml-root <dir>]..."
-              << " [--languages <lang[,lang...]>] [--overlay <dir>]...\n";
+              << " [--languages <lang[,lang...]>] [--overlay <dir>]... [--jobs <n>]"
+              << " [--cache-dir <dir> | --no-cache]\n"
+              << "       " << argv0 << " --index-qt [--cache-dir <dir>] [--jobs <n>]\n";
 }
 
 std::optional<Args> parseArgs(int argc, char** argv) {
@@ -31,6 +34,22 @@ std::optional<Args> parseArgs(int argc, char** argv) {
             }
         } else if (a == "--overlay" && i + 1 < argc) {
             args.overlays.emplace_back(argv[++i]);
+        } else if (a == "--jobs" && i + 1 < argc) {
+            std::string_view n(argv[++i]);
+            unsigned jobs = 0;
+            auto [end, err] = std::from_chars(n.data(), n.data() + n.size(), jobs);
+            if (err != std::errc() || end != n.data() + n.size()) {
+                std::cerr << "Invalid --jobs value: " << n << "\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+            args.jobs = jobs;
+        } else if (a == "--cache-dir" && i + 1 < argc) {
+            args.cacheDir = fs::path(argv[++i]);
+        } else if (a == "--no-cache") {
+            args.noCache = true;
+        } else if (a == "--index-qt") {
+            args.indexQt = true;
         } else if (a == "-h" || a == "--help") {
             printUsage(argv[0]);
             return std::nullopt;
@@ -40,7 +59,7 @@ std::optional<Args> parseArgs(int argc, char** argv) {
             return std::nullopt;
         }
     }
-    if (args.binaryPath.empty() || args.outDir.empty()) {
+    if (!args.indexQt && (args.binaryPath.empty() || args.outDir.empty())) {
         printUsage(argv[0]);
         return std::nullopt;
     }
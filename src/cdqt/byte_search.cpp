@@ -0,0 +1,47 @@
+#include "byte_search.h"
+
+#include <cstring>
+#include <utility>
+
+namespace cdqt {
+
+MultiPatternScanner::MultiPatternScanner(std::vector<std::vector<std::uint8_t>> patterns)
+    : patterns_(std::move(patterns)) {
+    for (std::size_t i = 0; i < patterns_.size(); ++i) {
+        if (patterns_[i].empty()) continue;
+        const std::uint8_t first = patterns_[i][0];
+        byFirstByte_[first].push_back(i);
+        if (singleFirstByte_ == -1) singleFirstByte_ = first;
+        else if (singleFirstByte_ != first) singleFirstByte_ = -2;
+    }
+    if (singleFirstByte_ < 0) singleFirstByte_ = -1;
+    for (auto& bucket : byFirstByte_) bucket.shrink_to_fit();
+}
+
+void MultiPatternScanner::scan(const std::uint8_t* data, std::size_t size, const MatchFn& onMatch) const {
+    if (!data || patterns_.empty()) return;
+    std::size_t pos = 0;
+    while (pos < size) {
+        if (singleFirstByte_ >= 0) {
+            const void* hit = std::memchr(data + pos, singleFirstByte_, size - pos);
+            if (!hit) return;
+            pos = static_cast<std::size_t>(static_cast<const std::uint8_t*>(hit) - data);
+        } else {
+            while (pos < size && byFirstByte_[data[pos]].empty()) ++pos;
+            if (pos == size) return;
+        }
+
+        std::size_t next = pos + 1;
+        for (std::size_t idx : byFirstByte_[data[pos]]) {
+            const auto& p = patterns_[idx];
+            if (p.size() > size - pos) continue;
+            if (std::memcmp(data + pos, p.data(), p.size()) != 0) continue;
+            const std::size_t resume = onMatch(idx, pos);
+            if (resume > pos) next = resume;
+            break;
+        }
+        pos = next;
+    }
+}
+
+} // namespace cdqt
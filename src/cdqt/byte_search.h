@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cdqt {
+
+// Finds every occurrence of a fixed set of byte patterns in one linear pass. Candidate positions are
+// located with memchr when all patterns share a first byte (the common case for key sets such as
+// "qt_*" in ASCII and UTF-16LE) and with a first-byte table otherwise; candidates are then confirmed
+// with memcmp against the patterns that start with that byte.
+class MultiPatternScanner {
+public:
+    explicit MultiPatternScanner(std::vector<std::vector<std::uint8_t>> patterns);
+
+    // Called for each match with the pattern index and the match offset; returns the offset at which
+    // scanning resumes (values <= offset resume at offset + 1).
+    using MatchFn = std::function<std::size_t(std::size_t pattern, std::size_t offset)>;
+
+    void scan(const std::uint8_t* data, std::size_t size, const MatchFn& onMatch) const;
+
+    const std::vector<std::uint8_t>& pattern(std::size_t i) const { return patterns_[i]; }
+
+private:
+    std::vector<std::vector<std::uint8_t>> patterns_;
+    std::array<std::vector<std::size_t>, 256> byFirstByte_;
+    int singleFirstByte_ = -1; // >= 0 when every pattern starts with the same byte
+};
+
+} // namespace cdqt
@@ -0,0 +1,171 @@
+#include "cache_io.h"
+
+#include <chrono>
+#include <fstream>
+#include <system_error>
+
+#include "mapped_file.h"
+#include "util.h"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cdqt {
+
+std::optional<FileIdentity> fileIdentity(const fs::path& p) {
+    FileIdentity id;
+#if defined(_WIN32)
+    std::error_code ec;
+    id.size = fs::file_size(p, ec);
+    if (ec) return std::nullopt;
+    auto t = fs::last_write_time(p, ec);
+    if (ec) return std::nullopt;
+    id.mtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+#else
+    struct stat st {};
+    if (::stat(p.c_str(), &st) != 0) return std::nullopt;
+    id.dev = static_cast<std::uint64_t>(st.st_dev);
+    id.ino = static_cast<std::uint64_t>(st.st_ino);
+    id.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+    id.mtimeNs = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    id.mtimeNs = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return id;
+}
+
+std::optional<FileIdentity> cacheIdentity(const fs::path& p) {
+    if (isNixStorePath(p)) return FileIdentity{};
+    return fileIdentity(p);
+}
+
+static bool ensureWritableDir(const fs::path& dir) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec || !fs::is_directory(dir, ec)) return false;
+#if defined(_WIN32)
+    return true;
+#else
+    return ::access(dir.c_str(), W_OK | X_OK) == 0;
+#endif
+}
+
+fs::path defaultCacheDir() {
+    fs::path dir;
+    const std::string xdg = getEnv("XDG_CACHE_HOME");
+    const std::string home = getEnv("HOME");
+    if (!xdg.empty()) dir = fs::path(xdg) / "crossdeployqt";
+    else if (!home.empty()) dir = fs::path(home) / ".cache" / "crossdeployqt";
+    if (dir.empty() || !ensureWritableDir(dir)) return {};
+    return dir;
+}
+
+std::uint32_t ByteReader::u32() {
+    if (!need(4)) return 0;
+    const std::uint32_t v = readU32(data + pos, false);
+    pos += 4;
+    return v;
+}
+
+std::uint64_t ByteReader::u64() {
+    if (!need(8)) return 0;
+    const std::uint64_t v = readU64(data + pos, false);
+    pos += 8;
+    return v;
+}
+
+std::string_view ByteReader::str() {
+    const std::uint32_t n = u32();
+    if (!need(n)) return {};
+    std::string_view s(reinterpret_cast<const char*>(data + pos), n);
+    pos += n;
+    return s;
+}
+
+std::vector<std::string> ByteReader::strings() {
+    std::vector<std::string> out;
+    const std::uint32_t n = u32();
+    for (std::uint32_t i = 0; i < n && ok; ++i) out.emplace_back(str());
+    return out;
+}
+
+std::optional<std::string> ByteReader::optString() {
+    if (u8() == 0) return std::nullopt;
+    return std::string(str());
+}
+
+FileIdentity ByteReader::identity() {
+    FileIdentity id;
+    id.dev = u64();
+    id.ino = u64();
+    id.size = u64();
+    id.mtimeNs = static_cast<std::int64_t>(u64());
+    return id;
+}
+
+void ByteWriter::u32(std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) buf.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void ByteWriter::u64(std::uint64_t v) {
+    for (int i = 0; i < 8; ++i) buf.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void ByteWriter::str(std::string_view s) {
+    u32(static_cast<std::uint32_t>(s.size()));
+    buf.append(s.data(), s.size());
+}
+
+void ByteWriter::strings(const std::vector<std::string>& v) {
+    u32(static_cast<std::uint32_t>(v.size()));
+    for (const auto& s : v) str(s);
+}
+
+void ByteWriter::optString(const std::optional<std::string>& s) {
+    u8(s ? 1 : 0);
+    if (s) str(*s);
+}
+
+void ByteWriter::identity(const FileIdentity& id) {
+    u64(id.dev);
+    u64(id.ino);
+    u64(id.size);
+    u64(static_cast<std::uint64_t>(id.mtimeNs));
+}
+
+void ByteWriter::patchU32(std::size_t offset, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) buf[offset + i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+}
+
+bool writeFileAtomic(const fs::path& file, std::string_view bytes) {
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec);
+    fs::path tmp = file;
+#if defined(_WIN32)
+    tmp += ".tmp";
+#else
+    tmp += ".tmp." + std::to_string(::getpid());
+#endif
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            out.close();
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    fs::rename(tmp, file, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+} // namespace cdqt
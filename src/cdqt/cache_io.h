@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cdqt {
+
+namespace fs = std::filesystem;
+
+// What identifies one version of a file on disk: a rewritten or replaced file changes at least one of
+// these.
+struct FileIdentity {
+    std::uint64_t dev = 0;
+    std::uint64_t ino = 0;
+    std::uint64_t size = 0;
+    std::int64_t mtimeNs = 0;
+
+    bool operator==(const FileIdentity& o) const {
+        return dev == o.dev && ino == o.ino && size == o.size && mtimeNs == o.mtimeNs;
+    }
+    bool operator!=(const FileIdentity& o) const { return !(*this == o); }
+};
+
+std::optional<FileIdentity> fileIdentity(const fs::path& p);
+
+// Identity to record in caches: fileIdentity, except that Nix store paths are immutable, so the path is
+// the identity and they get the all-zero one without a stat.
+std::optional<FileIdentity> cacheIdentity(const fs::path& p);
+
+// $XDG_CACHE_HOME/crossdeployqt, or ~/.cache/crossdeployqt, created if missing. Empty if neither
+// variable is set or the directory cannot be written (e.g. HOME=/homeless-shelter in a Nix build), which
+// turns caching off rather than failing every cache write.
+fs::path defaultCacheDir();
+
+// Bounds-checked little-endian reader over a mapped cache file. After any read runs past the end, `ok`
+// is false and every further read returns zero/empty.
+struct ByteReader {
+    const std::uint8_t* data;
+    std::size_t size;
+    std::size_t pos = 0;
+    bool ok = true;
+
+    bool need(std::size_t n) {
+        if (!ok || n > size - pos) ok = false;
+        return ok;
+    }
+    std::uint8_t u8() { return need(1) ? data[pos++] : 0; }
+    std::uint32_t u32();
+    std::uint64_t u64();
+    std::string_view str();
+    std::vector<std::string> strings();
+    std::optional<std::string> optString();
+    FileIdentity identity();
+};
+
+struct ByteWriter {
+    std::string buf;
+
+    void u8(std::uint8_t v) { buf.push_back(static_cast<char>(v)); }
+    void u32(std::uint32_t v);
+    void u64(std::uint64_t v);
+    void str(std::string_view s);
+    void strings(const std::vector<std::string>& v);
+    void optString(const std::optional<std::string>& s);
+    void identity(const FileIdentity& id);
+    // Overwrites a u32 written earlier at `offset` (e.g. a count only known at the end).
+    void patchU32(std::size_t offset, std::uint32_t v);
+};
+
+// Replaces `file` with `bytes` through a temporary file and a rename, so concurrent readers see either
+// the old or the new content, never a partial file.
+bool writeFileAtomic(const fs::path& file, std::string_view bytes);
+
+} // namespace cdqt
@@ -20,6 +20,10 @@ struct Args {
     std::vector<fs::path> qmlRoots;
     std::vector<std::string> languages;
     std::vector<fs::path> overlays; // optional overlay roots to merge into output
+    unsigned jobs = 0;              // --jobs; 0 = one per hardware thread
+    fs::path cacheDir;              // --cache-dir; empty = default location
+    bool noCache = false;           // --no-cache
+    bool indexQt = false;           // --index-qt: index the Qt installation instead of deploying
 };
 
 struct DeployPlan {
@@ -29,6 +33,8 @@ struct DeployPlan {
     std::vector<fs::path> qmlRoots;       // optional CLI-provided QML roots
     std::vector<std::string> languages;   // optional languages
     std::vector<fs::path> overlays;       // optional overlay roots
+    unsigned jobs = 0;                    // concurrent tool runs/file edits; 0 = one per hardware thread
+    fs::path cacheDir;                    // persistent caches across runs; empty = disabled
 };
 
 const char* toString(BinaryType t);
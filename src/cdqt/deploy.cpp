@@ -2,11 +2,15 @@
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
+#include <optional>
 
 #include "fs_ops.h"
 #include "macho_fixups.h"
 #include "pe_patch.h"
+#include "persistent_cache.h"
 #include "qml.h"
+#include "qt_index.h"
 #include "qt_paths.h"
 #include "resolve.h"
 #include "stage.h"
@@ -21,8 +25,8 @@ static void printResolved(const std::vector<fs::path>& libs) {
     for (const auto& p : libs) std::cout << "  " << p << "\n";
 }
 
-static void deployPE(const DeployPlan& plan) {
-    auto libs = resolveAndRecurse(plan);
+static void deployPE(const DeployPlan& plan, DeploySession& session) {
+    auto libs = resolveAndRecurse(session);
     printResolved(libs);
     copyResolvedForPE(plan, libs);
     copyMainPE(plan);
@@ -43,52 +47,59 @@ static void deployPE(const DeployPlan& plan) {
         }
     }
 
-    ResolveContext ctx{plan, queryQtPaths(), {}, {}, {}, {}};
-    ensureEnvForResolution(ctx);
+    const ResolveContext& ctx = session.ctx;
     copyPluginsPE(ctx, plan, libs);
     copyQmlModules(ctx, plan);
     deployTranslations(ctx, plan);
-    resolveQmlPluginDependencies(plan);
+    resolveQmlPluginDependencies(session);
 }
 
-static void deployELF(const DeployPlan& plan) {
-    auto libs = resolveAndRecurse(plan);
+static void deployELF(const DeployPlan& plan, DeploySession& session) {
+    auto libs = resolveAndRecurse(session);
     printResolved(libs);
     copyResolvedForELF(plan, libs);
     copyMainAndPatchELF(plan);
 
-    ResolveContext ctx{plan, queryQtPaths(), {}, {}, {}, {}};
-    ensureEnvForResolution(ctx);
+    const ResolveContext& ctx = session.ctx;
     copyPluginsELF(ctx, plan);
     copyQmlModules(ctx, plan);
     deployTranslations(ctx, plan);
     applyOverlays(plan);
     copyPluginsELF(ctx, plan);
-    resolveQmlPluginDependencies(plan);
+    resolveQmlPluginDependencies(session);
 }
 
-static void deployMachO(const DeployPlan& plan) {
-    auto libs = resolveAndRecurse(plan);
+static void deployMachO(const DeployPlan& plan, DeploySession& session) {
+    auto libs = resolveAndRecurse(session);
     printResolved(libs);
     copyResolvedForMachO(plan, libs);
     copyMainAndPatchMachO(plan);
 
-    ResolveContext ctx{plan, queryQtPaths(), {}, {}, {}, {}};
-    ensureEnvForResolution(ctx);
+    const ResolveContext& ctx = session.ctx;
     copyPluginsMachO(ctx, plan);
     copyQmlModules(ctx, plan);
     deployTranslations(ctx, plan);
     applyOverlays(plan);
-    resolveQmlPluginDependencies(plan);
+    resolveQmlPluginDependencies(session);
     fixInstallNamesMachO(plan);
 }
 
 void deploy(const DeployPlan& plan) {
     ensureOutputLayout(plan);
+    std::optional<PersistentParseCache> store;
+    if (!plan.cacheDir.empty()) store.emplace(plan.cacheDir);
+    PersistentParseCache* storePtr = store ? &*store : nullptr;
+    std::unique_ptr<QtIndex> index;
+    if (!plan.cacheDir.empty()) index = QtIndex::open(plan.cacheDir, queryQtPaths());
+    DeploySession session(plan, storePtr, index.get());
     switch (plan.type) {
-        case BinaryType::PE: deployPE(plan); break;
-        case BinaryType::ELF: deployELF(plan); break;
-        case BinaryType::MACHO: deployMachO(plan); break;
+        case BinaryType::PE: deployPE(plan, session); break;
+        case BinaryType::ELF: deployELF(plan, session); break;
+        case BinaryType::MACHO: deployMachO(plan, session); break;
+    }
+    if (store) {
+        if (isVerbose()) std::cout << "[cache] parse hits: " << store->hits() << "\n";
+        if (!store->save()) std::cerr << "Warning: failed to write parse cache in " << plan.cacheDir << "\n";
     }
 }
 
@@ -2,183 +2,292 @@
 
 #include <algorithm>
 #include <cctype>
-#include <sstream>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
+#include "elf_reader.h"
+#include "macho_reader.h"
+#include "object_file.h"
+#include "pe_reader.h"
+#include "persistent_cache.h"
+#include "qt_index.h"
 #include "util.h"
 
 namespace cdqt {
 
 std::string canonicalKey(const fs::path& p) {
-    std::error_code ec;
-    fs::path c = fs::weakly_canonical(p, ec);
-    return (ec ? p : c).string();
+    return canonicalPath(p).string();
 }
 
-const ParseResult& parseDepsCached(const fs::path& subject, BinaryType type, ParseCache& cache) {
-    const std::string key = canonicalKey(subject);
-    auto it = cache.parseByPath.find(key);
-    if (it != cache.parseByPath.end()) return it->second;
-    ParseResult pr;
-    if (type == BinaryType::ELF) pr = parseELF(subject);
-    else if (type == BinaryType::PE) pr = parsePE(subject);
-    else pr = parseMachO(subject);
-    auto [insIt, _] = cache.parseByPath.emplace(key, std::move(pr));
-    return insIt->second;
-}
+// Tool-backed fallbacks. objdump and llvm-otool accept many inputs per invocation and print a header
+// before each file's output, so a whole batch of files shares one process; the line parsers below are
+// fed the lines belonging to one file at a time.
 
-const std::vector<std::string>& machoRpathsFor(const fs::path& subject, ParseCache& cache) {
-    const std::string key = canonicalKey(subject);
-    auto it = cache.machoRpathsByPath.find(key);
-    if (it != cache.machoRpathsByPath.end()) return it->second;
-    auto r = parseMachORpaths(subject);
-    auto [insIt, _] = cache.machoRpathsByPath.emplace(key, std::move(r.rpaths));
-    return insIt->second;
+// "  DLL Name: KERNEL32.dll"
+static void peObjdumpLine(std::string_view line, ParseResult& r) {
+    auto pos = line.find("DLL Name:");
+    if (pos == std::string_view::npos) return;
+    std::string_view name = trimWhitespace(line.substr(pos + 9));
+    if (!name.empty()) r.dependencies.emplace_back(name);
 }
 
-ParseResult parsePE(const fs::path& bin) {
-    ParseResult r;
-    int code = 0;
-    std::string out = runCommand("x86_64-w64-mingw32-objdump -p " + shellEscape(bin.string()), code);
-    if (code != 0) return r;
-    std::istringstream iss(out);
-    std::string line;
-    while (std::getline(iss, line)) {
-        auto pos = line.find("DLL Name:");
-        if (pos != std::string::npos) {
-            std::string name = line.substr(pos + 9);
-            size_t i = 0; while (i < name.size() && (name[i] == ' ' || name[i] == '\t')) ++i;
-            name = name.substr(i);
-            while (!name.empty() && (name.back() == '\r' || name.back() == '\n' || name.back() == ' ' || name.back() == '\t')) name.pop_back();
-            if (!name.empty()) r.dependencies.push_back(name);
+// Dynamic section lines look like "  NEEDED               libfoo.so.1"; the value is the last field.
+static void elfObjdumpLine(std::string_view line, ParseResult& r) {
+    auto lastField = [](std::string_view l) -> std::string_view {
+        l = trimWhitespace(l);
+        auto pos = l.find_last_of(' ');
+        return pos == std::string_view::npos ? std::string_view() : l.substr(pos + 1);
+    };
+    if (line.find("NEEDED") != std::string_view::npos) {
+        std::string_view name = lastField(line);
+        if (!name.empty()) r.dependencies.emplace_back(name);
+    }
+    if (line.find("SONAME") != std::string_view::npos) {
+        std::string_view name = lastField(line);
+        if (!name.empty()) r.soname = std::string(name);
+    }
+    if (line.find("RPATH") != std::string_view::npos || line.find("RUNPATH") != std::string_view::npos) {
+        std::string_view paths = lastField(line);
+        while (!paths.empty()) {
+            auto colon = paths.find(':');
+            std::string_view p = paths.substr(0, colon);
+            if (!p.empty()) r.rpaths.emplace_back(p);
+            if (colon == std::string_view::npos) break;
+            paths.remove_prefix(colon + 1);
         }
     }
-    return r;
 }
 
-ParseResult parseELF(const fs::path& bin) {
-    ParseResult r;
-    int code = 0;
-    std::string out = runCommand("objdump -p " + shellEscape(bin.string()), code);
-    if (code != 0) return r;
-    std::istringstream iss(out);
-    std::string line;
-    while (std::getline(iss, line)) {
-        auto npos = line.find("NEEDED");
-        if (npos != std::string::npos) {
-            auto pos = line.find_last_of(' ');
-            if (pos != std::string::npos && pos + 1 < line.size()) {
-                std::string name = line.substr(pos + 1);
-                while (!name.empty() && (name.back() == '\r' || name.back() == '\n')) name.pop_back();
-                if (!name.empty()) r.dependencies.push_back(name);
-            }
-        }
-        auto rppos = line.find("RPATH");
-        if (rppos != std::string::npos) {
-            auto pos = line.find_last_of(' ');
-            if (pos != std::string::npos && pos + 1 < line.size()) {
-                std::string paths = line.substr(pos + 1);
-                for (const auto& p : splitPaths(paths, ':')) r.rpaths.push_back(p);
-            }
+// `llvm-otool -l` prints "cmd LC_..." and then the command's fields; the load command being read is
+// carried from line to line.
+enum class OtoolCmd { Other, Rpath, Id, Load };
+
+static void otoolLine(std::string_view line, ParseResult& r, OtoolCmd& cmd) {
+    // "name /usr/lib/libfoo.dylib (offset 24)" -> "/usr/lib/libfoo.dylib"
+    auto value = [](std::string_view s) {
+        auto paren = s.find(" (");
+        if (paren != std::string_view::npos) s = s.substr(0, paren);
+        return trimWhitespace(s);
+    };
+    auto cpos = line.find("cmd LC_");
+    if (cpos != std::string_view::npos) {
+        std::string_view name = value(line.substr(cpos + 4));
+        if (name == "LC_RPATH") cmd = OtoolCmd::Rpath;
+        else if (name == "LC_ID_DYLIB") cmd = OtoolCmd::Id;
+        else if (name == "LC_LOAD_DYLIB" || name == "LC_LOAD_WEAK_DYLIB" || name == "LC_REEXPORT_DYLIB" ||
+                 name == "LC_LAZY_LOAD_DYLIB" || name == "LC_LOAD_UPWARD_DYLIB") cmd = OtoolCmd::Load;
+        else cmd = OtoolCmd::Other;
+        return;
+    }
+    if (cmd == OtoolCmd::Rpath) {
+        auto pos = line.find("path ");
+        if (pos != std::string_view::npos) {
+            std::string_view p = value(line.substr(pos + 5));
+            if (!p.empty()) r.rpaths.emplace_back(p);
+            cmd = OtoolCmd::Other;
         }
-        auto runpos = line.find("RUNPATH");
-        if (runpos != std::string::npos) {
-            auto pos = line.find_last_of(' ');
-            if (pos != std::string::npos && pos + 1 < line.size()) {
-                std::string paths = line.substr(pos + 1);
-                for (const auto& p : splitPaths(paths, ':')) r.rpaths.push_back(p);
+    } else if (cmd == OtoolCmd::Id || cmd == OtoolCmd::Load) {
+        auto pos = line.find("name ");
+        if (pos != std::string_view::npos) {
+            std::string_view n = value(line.substr(pos + 5));
+            if (!n.empty()) {
+                if (cmd == OtoolCmd::Id) r.installName = std::string(n);
+                else r.dependencies.emplace_back(n);
             }
+            cmd = OtoolCmd::Other;
         }
     }
-    return r;
 }
 
-std::optional<std::string> queryElfSoname(const fs::path& soPath) {
-    int code = 0;
-    std::string out = runCommand("objdump -p " + shellEscape(soPath.string()), code);
-    if (code != 0) return std::nullopt;
-    std::istringstream iss(out);
-    std::string line;
-    while (std::getline(iss, line)) {
-        auto pos = line.find("SONAME");
-        if (pos != std::string::npos) {
-            auto sp = line.find_last_of(' ');
-            if (sp != std::string::npos && sp + 1 < line.size()) {
-                std::string name = line.substr(sp + 1);
-                while (!name.empty() && (name.back() == '\r' || name.back() == '\n')) name.pop_back();
-                if (!name.empty()) return name;
+// The input file a per-file header line introduces, if `line` is one:
+//   objdump:    "<file>:     file format elf64-x86-64"
+//   llvm-otool: "<file>:" or "<file> (architecture arm64):"
+static std::string_view toolFileHeader(std::string_view line, BinaryType type) {
+    if (type != BinaryType::MACHO) {
+        auto pos = line.find(":     file format ");
+        return pos == std::string_view::npos ? std::string_view() : line.substr(0, pos);
+    }
+    if (line.empty() || line.back() != ':' || line.front() == ' ' || line.front() == '\t') return {};
+    line.remove_suffix(1);
+    auto arch = line.rfind(" (architecture ");
+    return arch == std::string_view::npos ? line : line.substr(0, arch);
+}
+
+// Runs one tool invocation over `bins` and splits its output back into one ParseResult per input.
+// Files the tool cannot read print no header and come back empty, like a failed single-file run.
+// Fat Mach-O files are restricted to slice `cpuType`, as the native reader is.
+static std::vector<ParseResult> parseWithToolBatch(const std::vector<fs::path>& bins, BinaryType type,
+                                                   std::uint32_t cpuType) {
+    std::vector<ParseResult> results(bins.size());
+    if (bins.empty()) return results;
+    std::vector<std::string> argv;
+    if (type == BinaryType::PE) argv = {"x86_64-w64-mingw32-objdump", "-p"};
+    else if (type == BinaryType::ELF) argv = {"objdump", "-p"};
+    else {
+        argv = {"llvm-otool", "-l"};
+        if (auto arch = machOArchName(cpuType)) argv.insert(argv.end(), {"-arch", *arch});
+    }
+    std::unordered_map<std::string_view, std::size_t> byName;
+    for (const auto& b : bins) argv.push_back(b.string());
+    for (std::size_t i = 0; i < bins.size(); ++i) byName.emplace(argv[argv.size() - bins.size() + i], i);
+
+    ParseResult* cur = nullptr;
+    OtoolCmd otoolCmd = OtoolCmd::Other;
+    const ProcessResult res = runProcess(argv, [&](std::string_view line) {
+        const std::string_view header = toolFileHeader(line, type);
+        if (!header.empty()) {
+            auto it = byName.find(header);
+            if (it != byName.end()) {
+                cur = &results[it->second];
+                otoolCmd = OtoolCmd::Other;
+                return;
             }
         }
-    }
-    return std::nullopt;
+        if (!cur) return;
+        if (type == BinaryType::PE) peObjdumpLine(line, *cur);
+        else if (type == BinaryType::ELF) elfObjdumpLine(line, *cur);
+        else otoolLine(line, *cur, otoolCmd);
+    });
+    if (res.exitCode != 0 && bins.size() == 1) results[0] = ParseResult{};
+    return results;
 }
 
-ParseResult parseMachO(const fs::path& bin) {
+static ParseResult fromPeImports(PeImports imports) {
     ParseResult r;
-    int code = 0;
-    std::string out = runCommand("llvm-otool -L " + shellEscape(bin.string()), code);
-    if (code != 0) return r;
-    std::istringstream iss(out);
-    std::string line;
-    bool first = true;
-    while (std::getline(iss, line)) {
-        if (first) { first = false; continue; }
-        size_t start = 0; while (start < line.size() && std::isspace(static_cast<unsigned char>(line[start]))) ++start;
-        size_t end = start;
-        while (end < line.size() && !std::isspace(static_cast<unsigned char>(line[end])) && line[end] != '(') ++end;
-        if (end > start) r.dependencies.push_back(line.substr(start, end - start));
+    r.dependencies = std::move(imports.imports);
+    // Delay-loaded DLLs are still loaded at runtime; keep them unless already imported directly.
+    auto lower = [](std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return std::tolower(c); });
+        return s;
+    };
+    for (auto& name : imports.delayImports) {
+        const std::string key = lower(name);
+        bool dup = std::any_of(r.dependencies.begin(), r.dependencies.end(), [&](const std::string& d){ return lower(d) == key; });
+        if (!dup) r.dependencies.push_back(std::move(name));
     }
     return r;
 }
 
-MachORpaths parseMachORpaths(const fs::path& bin) {
-    MachORpaths r;
-    int code = 0;
-    std::string out = runCommand(std::string("llvm-otool -l ") + shellEscape(bin.string()), code);
-    if (code != 0 || out.empty()) return r;
-    std::istringstream iss(out);
-    std::string line;
-    bool inRpath = false;
-    while (std::getline(iss, line)) {
-        if (line.find("cmd LC_RPATH") != std::string::npos) { inRpath = true; continue; }
-        if (inRpath) {
-            auto pos = line.find("path ");
-            if (pos != std::string::npos) {
-                std::string s = line.substr(pos + 5);
-                auto paren = s.find(" (");
-                if (paren != std::string::npos) s = s.substr(0, paren);
-                while (!s.empty() && (s.back()=='\n' || s.back()=='\r' || s.back()==' ' || s.back()=='\t')) s.pop_back();
-                size_t i=0; while (i<s.size() && (s[i]==' '||s[i]=='\t')) ++i; s = s.substr(i);
-                if (!s.empty()) r.rpaths.push_back(s);
-                inRpath = false;
-            }
-        }
-    }
+static ParseResult fromElfDynamic(ElfDynamicInfo dyn) {
+    ParseResult r;
+    r.dependencies = std::move(dyn.needed);
+    r.rpaths = std::move(dyn.rpath);
+    r.rpaths.insert(r.rpaths.end(), dyn.runpath.begin(), dyn.runpath.end());
+    r.soname = std::move(dyn.soname);
+    return r;
+}
+
+static ParseResult fromMachOLoadCommands(MachOLoadCommands lc) {
+    ParseResult r;
+    r.dependencies = std::move(lc.dylibs);
+    r.rpaths = std::move(lc.rpaths);
+    r.installName = std::move(lc.installName);
     return r;
 }
 
-std::pair<std::optional<std::string>, std::vector<std::string>> parseOtoolDepsWithId(const fs::path& bin) {
-    int code = 0;
-    std::string out = runCommand("llvm-otool -L " + shellEscape(bin.string()), code);
-    std::optional<std::string> id;
-    std::vector<std::string> deps;
-    if (code != 0 || out.empty()) return {id, deps};
-    std::istringstream iss(out);
-    std::string line;
-    bool first = true;
-    bool tookId = false;
-    while (std::getline(iss, line)) {
-        if (first) { first = false; continue; }
-        size_t start = 0; while (start < line.size() && std::isspace(static_cast<unsigned char>(line[start]))) ++start;
-        size_t end = start;
-        while (end < line.size() && !std::isspace(static_cast<unsigned char>(line[end])) && line[end] != '(') ++end;
-        if (end <= start) continue;
-        std::string token = line.substr(start, end - start);
-        if (!tookId) { id = token; tookId = true; continue; }
-        deps.push_back(token);
+// Parses `bin` with the native reader for `type`; nullopt if the file cannot be mapped or the reader
+// fails, in which case the external tool has to be used instead.
+static std::optional<ParseResult> parseNative(const fs::path& bin, BinaryType type, std::uint32_t cpuType) {
+    auto obj = ObjectFile::open(bin);
+    if (!obj) return std::nullopt;
+    if (type == BinaryType::ELF) {
+        if (auto dyn = readElfDynamic(*obj)) return fromElfDynamic(std::move(*dyn));
+    } else if (type == BinaryType::PE) {
+        if (auto imports = readPeImports(*obj)) return fromPeImports(std::move(*imports));
+    } else {
+        if (auto lc = readMachOLoadCommands(*obj, cpuType)) return fromMachOLoadCommands(std::move(*lc));
     }
-    return {id, deps};
+    return std::nullopt;
 }
 
-} // namespace cdqt
+static ParseResult parseFile(const fs::path& bin, BinaryType type, std::uint32_t cpuType) {
+    if (auto r = parseNative(bin, type, cpuType)) return std::move(*r);
+    // Slice 0 is the file's first slice, for the tool as for the native reader.
+    if (type == BinaryType::MACHO && cpuType == 0) {
+        if (auto arch = peekTargetArch(bin); arch && !arch->machines.empty()) cpuType = arch->machines.front();
+    }
+    return std::move(parseWithToolBatch({bin}, type, cpuType).front());
+}
+
+ParseResult parsePE(const fs::path& bin) {
+    return parseFile(bin, BinaryType::PE, 0);
+}
+
+ParseResult parseELF(const fs::path& bin) {
+    return parseFile(bin, BinaryType::ELF, 0);
+}
+
+ParseResult parseMachO(const fs::path& bin, std::uint32_t cpuType) {
+    return parseFile(bin, BinaryType::MACHO, cpuType);
+}
+
+std::optional<std::string> queryElfSoname(const fs::path& soPath) {
+    return parseELF(soPath).soname;
+}
+
+// A result parsed on an earlier run: from the Qt index, else from the persistent cache.
+static std::optional<ParseResult> lookupStored(const std::string& key, BinaryType type, const ParseCache& cache) {
+    if (cache.index) {
+        if (auto indexed = cache.index->parsed(key, type, cache.machoCpuType)) return indexed;
+    }
+    if (!cache.persistent) return std::nullopt;
+    return cache.persistent->lookup(key, type, cache.machoCpuType);
+}
+
+// Looks `key` up in memory. The lock is held only for the lookup; entries are never removed, so the
+// pointer stays valid.
+static const ParseResult* findCached(const std::string& key, ParseCache& cache) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.parseByPath.find(key);
+    return it == cache.parseByPath.end() ? nullptr : &it->second;
+}
 
+// Adds a result to memory. If two threads parsed the same file, the first result is kept.
+static const ParseResult& remember(std::string key, ParseResult result, ParseCache& cache) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.parseByPath.emplace(std::move(key), std::move(result)).first->second;
+}
+
+// Stores a fresh parse in memory and, unless it came back empty (often a failed parse), on disk.
+static const ParseResult& rememberParse(std::string key, BinaryType type, ParseResult result, ParseCache& cache) {
+    const bool empty = result.dependencies.empty() && result.rpaths.empty() && !result.installName && !result.soname;
+    if (cache.persistent && !empty) cache.persistent->store(key, type, cache.machoCpuType, result);
+    return remember(std::move(key), std::move(result), cache);
+}
 
+const ParseResult& parseDepsCached(const fs::path& subject, BinaryType type, ParseCache& cache) {
+    std::string key = canonicalKey(subject);
+    if (const ParseResult* hit = findCached(key, cache)) return *hit;
+    if (auto stored = lookupStored(key, type, cache)) return remember(std::move(key), std::move(*stored), cache);
+    return rememberParse(std::move(key), type, parseFile(subject, type, cache.machoCpuType), cache);
+}
+
+const ParseResult* parseDepsNative(const fs::path& subject, BinaryType type, ParseCache& cache) {
+    std::string key = canonicalKey(subject);
+    if (const ParseResult* hit = findCached(key, cache)) return hit;
+    if (auto stored = lookupStored(key, type, cache)) return &remember(std::move(key), std::move(*stored), cache);
+    auto parsed = parseNative(subject, type, cache.machoCpuType);
+    if (!parsed) return nullptr;
+    return &rememberParse(std::move(key), type, std::move(*parsed), cache);
+}
+
+void parseDepsWithTool(const std::vector<fs::path>& subjects, BinaryType type, ParseCache& cache) {
+    if (subjects.empty()) return;
+    if (isVerbose()) logLine("[deps] tool fallback for ", subjects.size(), " file(s)");
+    for (std::size_t start = 0; start < subjects.size(); start += kToolBatchSize) {
+        const std::vector<fs::path> batch(subjects.begin() + start,
+                                          subjects.begin() + std::min(subjects.size(), start + kToolBatchSize));
+        auto results = parseWithToolBatch(batch, type, cache.machoCpuType);
+        for (std::size_t i = 0; i < batch.size(); ++i) rememberParse(canonicalKey(batch[i]), type, std::move(results[i]), cache);
+    }
+}
+
+const std::vector<std::string>& machoRpathsFor(const fs::path& subject, ParseCache& cache) {
+    return parseDepsCached(subject, BinaryType::MACHO, cache).rpaths;
+}
+
+} // namespace cdqt
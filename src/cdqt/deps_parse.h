@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -9,32 +12,45 @@
 
 namespace cdqt {
 
+class PersistentParseCache;
+class QtIndex;
+
 struct ParseResult {
     std::vector<std::string> dependencies; // names or paths
-    std::vector<std::string> rpaths;       // for ELF (RPATH/RUNPATH)
+    std::vector<std::string> rpaths;       // ELF RPATH/RUNPATH, Mach-O LC_RPATH
+    std::optional<std::string> installName; // Mach-O LC_ID_DYLIB
+    std::optional<std::string> soname;      // ELF DT_SONAME
 };
 
-struct MachORpaths { std::vector<std::string> rpaths; };
-
+// Parse results by canonical path. Safe to share between threads: lookups and inserts take `mutex`,
+// parsing runs unlocked, and entries are never removed, so returned references stay valid.
 struct ParseCache {
     std::unordered_map<std::string, ParseResult> parseByPath;
-    std::unordered_map<std::string, std::vector<std::string>> machoRpathsByPath;
+    std::uint32_t machoCpuType = 0; // fat slice to read; 0 = each file's first slice
+    PersistentParseCache* persistent = nullptr; // optional cross-run cache consulted before parsing
+    const QtIndex* index = nullptr;              // optional prebuilt Qt index, consulted first
+    std::mutex mutex;                            // guards parseByPath
 };
 
 ParseResult parsePE(const fs::path& bin);
 ParseResult parseELF(const fs::path& bin);
-ParseResult parseMachO(const fs::path& bin);
-MachORpaths parseMachORpaths(const fs::path& bin);
+ParseResult parseMachO(const fs::path& bin, std::uint32_t cpuType = 0);
 
 std::optional<std::string> queryElfSoname(const fs::path& soPath);
 
 std::string canonicalKey(const fs::path& p);
 const ParseResult& parseDepsCached(const fs::path& subject, BinaryType type, ParseCache& cache);
-const std::vector<std::string>& machoRpathsFor(const fs::path& subject, ParseCache& cache);
 
-// Mach-O fixups need to parse otool output with the dylib ID (first token line).
-std::pair<std::optional<std::string>, std::vector<std::string>> parseOtoolDepsWithId(const fs::path& bin);
-
-} // namespace cdqt
+// Files per objdump/llvm-otool process when the native readers cannot handle them; keeps the command
+// line well below ARG_MAX even for long store paths.
+constexpr std::size_t kToolBatchSize = 64;
 
+// The result for `subject` if it is cached, stored from an earlier run or readable by the native
+// readers (parsing it now); nullptr when only the external tool can read it.
+const ParseResult* parseDepsNative(const fs::path& subject, BinaryType type, ParseCache& cache);
+// Parses `subjects` with objdump or llvm-otool, one process per kToolBatchSize files, and caches the
+// results.
+void parseDepsWithTool(const std::vector<fs::path>& subjects, BinaryType type, ParseCache& cache);
+const std::vector<std::string>& machoRpathsFor(const fs::path& subject, ParseCache& cache);
 
+} // namespace cdqt
@@ -0,0 +1,546 @@
+#include "elf_patch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include "mapped_file.h"
+#include "object_file.h"
+
+namespace cdqt {
+
+namespace {
+
+constexpr std::uint32_t PT_LOAD = 1;
+constexpr std::uint32_t PT_DYNAMIC = 2;
+constexpr std::uint32_t PT_INTERP = 3;
+constexpr std::uint32_t PT_NOTE = 4;
+constexpr std::uint32_t PT_PHDR = 6;
+constexpr std::uint32_t PT_GNU_PROPERTY = 0x6474e553;
+
+constexpr std::uint32_t PF_W = 2;
+constexpr std::uint32_t PF_R = 4;
+
+constexpr std::uint32_t SHT_SYMTAB = 2;
+constexpr std::uint32_t SHT_STRTAB = 3;
+constexpr std::uint32_t SHT_RELA = 4;
+constexpr std::uint32_t SHT_DYNAMIC = 6;
+constexpr std::uint32_t SHT_NOTE = 7;
+constexpr std::uint32_t SHT_NOBITS = 8;
+constexpr std::uint32_t SHT_REL = 9;
+constexpr std::uint32_t SHT_DYNSYM = 11;
+constexpr std::uint32_t SHT_GROUP = 17;
+constexpr std::uint32_t SHT_SYMTAB_SHNDX = 18;
+
+constexpr std::uint64_t SHF_INFO_LINK = 0x40;
+
+constexpr std::uint64_t SHN_UNDEF = 0;
+constexpr std::uint64_t SHN_LORESERVE = 0xFF00;
+
+constexpr std::uint64_t DT_NULL = 0;
+constexpr std::uint64_t DT_NEEDED = 1;
+constexpr std::uint64_t DT_PLTRELSZ = 2;
+constexpr std::uint64_t DT_HASH = 4;
+constexpr std::uint64_t DT_STRTAB = 5;
+constexpr std::uint64_t DT_SYMTAB = 6;
+constexpr std::uint64_t DT_RELA = 7;
+constexpr std::uint64_t DT_RELASZ = 8;
+constexpr std::uint64_t DT_STRSZ = 10;
+constexpr std::uint64_t DT_SONAME = 14;
+constexpr std::uint64_t DT_RPATH = 15;
+constexpr std::uint64_t DT_REL = 17;
+constexpr std::uint64_t DT_RELSZ = 18;
+constexpr std::uint64_t DT_JMPREL = 23;
+constexpr std::uint64_t DT_RUNPATH = 29;
+constexpr std::uint64_t DT_RELRSZ = 35;
+constexpr std::uint64_t DT_RELR = 36;
+constexpr std::uint64_t DT_GNU_HASH = 0x6FFFFEF5;
+constexpr std::uint64_t DT_VERSYM = 0x6FFFFFF0;
+constexpr std::uint64_t DT_VERDEF = 0x6FFFFFFC;
+constexpr std::uint64_t DT_VERNEED = 0x6FFFFFFE;
+
+struct DynEntry {
+    std::uint64_t fileOffset; // of the entry itself
+    std::uint64_t tag;
+    std::uint64_t val;
+};
+
+std::uint64_t getInt(const std::uint8_t* p, std::size_t n, bool be) {
+    return n == 8 ? readU64(p, be) : n == 4 ? readU32(p, be) : readU16(p, be);
+}
+
+void putInt(std::uint8_t* out, std::uint64_t v, std::size_t n, bool be) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::size_t shift = 8 * (be ? (n - 1 - i) : i);
+        out[i] = static_cast<std::uint8_t>((v >> shift) & 0xFF);
+    }
+}
+
+std::vector<std::uint8_t> encodeInt(std::uint64_t v, std::size_t n, bool be) {
+    std::vector<std::uint8_t> out(n);
+    putInt(out.data(), v, n, be);
+    return out;
+}
+
+std::vector<std::uint8_t> encodeWord(std::uint64_t v, bool is64, bool be) {
+    return encodeInt(v, is64 ? 8 : 4, be);
+}
+
+// Dynamic entries holding the address of a table only the dynamic linker reads, which can therefore
+// move as long as the entry follows it.
+bool isTableAddress(std::uint64_t tag) {
+    switch (tag) {
+        case DT_HASH: case DT_GNU_HASH: case DT_STRTAB: case DT_SYMTAB: case DT_VERSYM: case DT_VERDEF:
+        case DT_VERNEED: case DT_RELA: case DT_REL: case DT_JMPREL: case DT_RELR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The entry giving the size of the table whose address `tag` holds, where the table may span several
+// sections (relocations) and must not be split; 0 for tables that are one section each.
+std::uint64_t tableSizeTag(std::uint64_t tag) {
+    switch (tag) {
+        case DT_RELA: return DT_RELASZ;
+        case DT_REL: return DT_RELSZ;
+        case DT_JMPREL: return DT_PLTRELSZ;
+        case DT_RELR: return DT_RELRSZ;
+        case DT_STRTAB: return DT_STRSZ;
+        default: return 0;
+    }
+}
+
+std::uint64_t alignUp(std::uint64_t v, std::uint64_t align) {
+    return (v + align - 1) / align * align;
+}
+
+// Field offsets within the ELF header, a program header, a section header and a symbol, for
+// ELFCLASS32/64.
+struct ElfLayout {
+    bool is64;
+    std::size_t word() const { return is64 ? 8 : 4; }
+    std::size_t phoff() const { return is64 ? 32 : 28; }
+    std::size_t shoff() const { return is64 ? 40 : 32; }
+    std::size_t phentsize() const { return is64 ? 54 : 42; }
+    std::size_t phnum() const { return is64 ? 56 : 44; }
+    std::size_t shentsize() const { return is64 ? 58 : 46; }
+    std::size_t shnum() const { return is64 ? 60 : 48; }
+    std::size_t shstrndx() const { return is64 ? 62 : 50; }
+    std::size_t phdrSize() const { return is64 ? 56 : 32; }
+    std::size_t phFlags() const { return is64 ? 4 : 24; }
+    std::size_t phOffset() const { return is64 ? 8 : 4; }
+    std::size_t phVaddr() const { return is64 ? 16 : 8; }
+    std::size_t phPaddr() const { return is64 ? 24 : 12; }
+    std::size_t phFilesz() const { return is64 ? 32 : 16; }
+    std::size_t phMemsz() const { return is64 ? 40 : 20; }
+    std::size_t phAlign() const { return is64 ? 48 : 28; }
+    std::size_t shdrSize() const { return is64 ? 64 : 40; }
+    std::size_t shType() const { return 4; }
+    std::size_t shFlags() const { return 8; }
+    std::size_t shAddr() const { return is64 ? 16 : 12; }
+    std::size_t shOffset() const { return is64 ? 24 : 16; }
+    std::size_t shSize() const { return is64 ? 32 : 20; }
+    std::size_t shLink() const { return is64 ? 40 : 24; }
+    std::size_t shInfo() const { return is64 ? 44 : 28; }
+    std::size_t shAlign() const { return is64 ? 48 : 32; }
+    std::size_t symSize() const { return is64 ? 24 : 16; }
+    std::size_t stValue() const { return is64 ? 8 : 4; }
+    std::size_t stShndx() const { return is64 ? 6 : 14; }
+};
+
+// Everything setElfRunpath learned about the file that a relocation needs.
+struct DynamicView {
+    const ObjectFile& obj;
+    bool is64;
+    bool be;
+    ElfSegment dyn;
+    const std::vector<DynEntry>& entries; // up to, not including, DT_NULL; `target` points into it
+    std::uint64_t strtabOff;
+    std::uint64_t strsz;
+    const DynEntry* target;        // RUNPATH/RPATH entry to repoint; nullptr to add one
+};
+
+// Puts the edited section headers in `table` (a copy of the file's) into offset order, as binutils
+// expects, and renumbers every reference to a section index to match: sh_link, sh_info of relocation
+// sections, e_shstrndx and the symbols' st_shndx. Symbols in a section that moved move with it. Returns
+// false for what it cannot renumber (extended section indices, section groups).
+bool sortSectionHeaders(const ObjectFile& obj, const ElfLayout& L, bool be, std::uint64_t shoff,
+                        const std::vector<std::uint8_t>& table, std::vector<FilePatch>& patches) {
+    const std::size_t word = L.word();
+    const std::size_t shnum = table.size() / L.shdrSize();
+    auto field = [&](std::size_t i, std::size_t at, std::size_t n) {
+        return getInt(table.data() + i * L.shdrSize() + at, n, be);
+    };
+    auto oldField = [&](std::size_t i, std::size_t at, std::size_t n) {
+        return getInt(obj.data() + shoff + i * L.shdrSize() + at, n, be);
+    };
+    const std::uint64_t shstrndx = obj.u16(L.shstrndx());
+    if (shstrndx >= shnum) return false;
+    for (std::size_t i = 0; i < shnum; ++i) {
+        const std::uint64_t type = field(i, L.shType(), 4);
+        if (type == SHT_GROUP || type == SHT_SYMTAB_SHNDX) return false;
+    }
+
+    std::vector<std::size_t> order(shnum);
+    for (std::size_t i = 0; i < shnum; ++i) order[i] = i;
+    std::stable_sort(order.begin() + 1, order.end(), [&](std::size_t a, std::size_t b) {
+        return field(a, L.shOffset(), word) < field(b, L.shOffset(), word);
+    });
+    std::vector<std::uint64_t> newIndex(shnum);
+    for (std::size_t i = 0; i < shnum; ++i) newIndex[order[i]] = i;
+
+    std::vector<std::uint8_t> sorted(table.size());
+    for (std::size_t i = 0; i < shnum; ++i) {
+        const std::size_t from = order[i];
+        std::uint8_t* sh = sorted.data() + i * L.shdrSize();
+        std::memcpy(sh, table.data() + from * L.shdrSize(), L.shdrSize());
+        const std::uint64_t type = field(from, L.shType(), 4);
+        const std::uint64_t link = field(from, L.shLink(), 4);
+        const std::uint64_t info = field(from, L.shInfo(), 4);
+        const bool infoIsIndex = type == SHT_REL || type == SHT_RELA || (field(from, L.shFlags(), word) & SHF_INFO_LINK);
+        if (link != 0 && link < shnum) putInt(sh + L.shLink(), newIndex[link], 4, be);
+        if (infoIsIndex && info != 0 && info < shnum) putInt(sh + L.shInfo(), newIndex[info], 4, be);
+    }
+
+    for (std::size_t i = 0; i < shnum; ++i) {
+        const std::uint64_t type = field(i, L.shType(), 4);
+        if (type != SHT_SYMTAB && type != SHT_DYNSYM) continue;
+        const std::uint64_t from = oldField(i, L.shOffset(), word);
+        const std::uint64_t size = field(i, L.shSize(), word);
+        if (!obj.inBounds(from, size)) return false;
+        std::vector<std::uint8_t> syms(obj.data() + from, obj.data() + from + size);
+        bool changed = false;
+        for (std::uint64_t at = 0; at + L.symSize() <= size; at += L.symSize()) {
+            std::uint8_t* sym = syms.data() + at;
+            const std::uint64_t ndx = readU16(sym + L.stShndx(), be);
+            if (ndx == SHN_UNDEF || ndx >= SHN_LORESERVE) continue;
+            if (ndx >= shnum) return false;
+            const std::uint64_t shift = field(ndx, L.shAddr(), word) - oldField(ndx, L.shAddr(), word);
+            if (newIndex[ndx] == ndx && shift == 0) continue;
+            putInt(sym + L.stShndx(), newIndex[ndx], 2, be);
+            putInt(sym + L.stValue(), getInt(sym + L.stValue(), word, be) + shift, word, be);
+            changed = true;
+        }
+        if (changed) patches.push_back({field(i, L.shOffset(), word), std::move(syms)});
+    }
+    patches.push_back({shoff, std::move(sorted)});
+    patches.push_back({L.shstrndx(), encodeInt(newIndex[shstrndx], 2, be)});
+    return true;
+}
+
+// Grows .dynstr by appending a copy with `runpath` at its end to the file, in a new PT_LOAD segment
+// placed above every existing one; DT_STRTAB/DT_STRSZ are repointed and the RUNPATH entry refers to
+// the new string. .dynamic moves there too when a DT_RUNPATH entry must be added and it has no spare
+// DT_NULL slot. The program header table takes the new entry where it is, the only place binutils
+// accepts it, so what follows it moves into the new segment as well, as patchelf does. The old copies
+// stay behind unused. Returns false if the layout does not allow it.
+bool relocateDynstr(const DynamicView& v, const std::string& runpath, std::vector<FilePatch>& patches) {
+    const ObjectFile& obj = v.obj;
+    const ElfLayout L{v.is64};
+    const std::size_t word = L.word();
+    const std::uint64_t entSize = 2 * word;
+    auto readInt = [&](std::uint64_t off, std::size_t n) { return getInt(obj.data() + off, n, v.be); };
+
+    const std::uint64_t phoff = readInt(L.phoff(), word);
+    const std::uint64_t phentsize = readInt(L.phentsize(), 2);
+    const std::uint64_t phnum = readInt(L.phnum(), 2);
+    if (phentsize != L.phdrSize() || phnum == 0 || phnum >= 0xFFFF) return false;
+    if (!obj.inBounds(phoff, phentsize * phnum)) return false;
+    auto ph = [&](std::uint64_t i, std::size_t at, std::size_t n) { return readInt(phoff + i * phentsize + at, n); };
+
+    const std::uint64_t shoff = readInt(L.shoff(), word);
+    const std::uint64_t shentsize = readInt(L.shentsize(), 2);
+    const std::uint64_t shnum = readInt(L.shnum(), 2);
+    if (shoff == 0 || shnum == 0 || shentsize != L.shdrSize() || !obj.inBounds(shoff, shentsize * shnum)) return false;
+    auto sh = [&](std::uint64_t i, std::size_t at, std::size_t n) { return readInt(shoff + i * shentsize + at, n); };
+
+    // New segment: file offset and address congruent with the first PT_LOAD, page aligned, above every
+    // mapped address.
+    std::uint64_t pageAlign = 0x1000, maxEnd = 0;
+    std::optional<std::uint64_t> bias;
+    std::size_t lastLoad = 0;
+    for (std::uint64_t i = 0; i < phnum; ++i) {
+        if (ph(i, 0, 4) != PT_LOAD) continue;
+        const std::uint64_t vaddr = ph(i, L.phVaddr(), word);
+        if (!bias) bias = vaddr - ph(i, L.phOffset(), word);
+        pageAlign = std::max(pageAlign, ph(i, L.phAlign(), word));
+        maxEnd = std::max(maxEnd, vaddr + ph(i, L.phMemsz(), word));
+        lastLoad = static_cast<std::size_t>(i);
+    }
+    if (!bias || *bias % pageAlign != 0) return false;
+
+    // The grown program header table must stay inside the PT_LOAD that maps it. Whatever it would overlap
+    // moves, together with anything sharing a section or segment with that, until the range is closed.
+    const std::uint64_t tableEnd = phoff + phentsize * phnum;
+    const std::uint64_t grownEnd = tableEnd + phentsize;
+    std::optional<std::uint64_t> tableLoad;
+    for (std::uint64_t i = 0; i < phnum && !tableLoad; ++i) {
+        const std::uint64_t off = ph(i, L.phOffset(), word);
+        if (ph(i, 0, 4) == PT_LOAD && off <= phoff && grownEnd <= off + ph(i, L.phFilesz(), word)) tableLoad = i;
+    }
+    if (!tableLoad) return false;
+    const std::uint64_t loadBias = ph(*tableLoad, L.phVaddr(), word) - ph(*tableLoad, L.phOffset(), word);
+    const std::uint64_t loadEnd = ph(*tableLoad, L.phOffset(), word) + ph(*tableLoad, L.phFilesz(), word);
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> spans; // (file offset, size) of multi-section tables
+    for (const auto& e : v.entries) {
+        const std::uint64_t sizeTag = tableSizeTag(e.tag);
+        if (sizeTag == 0 || e.val < loadBias || e.val - loadBias >= loadEnd) continue;
+        for (const auto& n : v.entries) if (n.tag == sizeTag) spans.emplace_back(e.val - loadBias, n.val);
+    }
+    std::uint64_t moveBegin = grownEnd, moveEnd = grownEnd;
+    auto inTheWay = [&](std::uint64_t off, std::uint64_t size) {
+        if (size == 0) return false;
+        return (off < grownEnd && off + size > tableEnd) || (off < moveEnd && off + size > moveBegin);
+    };
+    for (bool grown = true; grown;) {
+        grown = false;
+        auto take = [&](std::uint64_t off, std::uint64_t size) {
+            if (!inTheWay(off, size) || (off >= moveBegin && off + size <= moveEnd)) return;
+            moveBegin = std::min(moveBegin, off);
+            moveEnd = std::max(moveEnd, off + size);
+            grown = true;
+        };
+        for (std::uint64_t i = 1; i < shnum; ++i) {
+            if (sh(i, L.shType(), 4) != SHT_NOBITS) take(sh(i, L.shOffset(), word), sh(i, L.shSize(), word));
+        }
+        for (std::uint64_t i = 0; i < phnum; ++i) {
+            const std::uint64_t type = ph(i, 0, 4);
+            if (type != PT_LOAD && type != PT_PHDR) take(ph(i, L.phOffset(), word), ph(i, L.phFilesz(), word));
+        }
+        for (const auto& [off, size] : spans) take(off, size);
+    }
+    if (moveBegin < tableEnd || moveEnd > loadEnd || !obj.inBounds(moveBegin, moveEnd - moveBegin)) return false;
+    auto isMoved = [&](std::uint64_t off, std::uint64_t size) {
+        return size != 0 && off >= moveBegin && off + size <= moveEnd;
+    };
+
+    // Only what nothing but program headers and dynamic entries refer to can move: .interp, notes and
+    // the dynamic linker's tables (hashes, symbols, versions, relocations), whose entries are repointed.
+    std::vector<std::uint64_t> tableAddrs;
+    for (const auto& e : v.entries) if (isTableAddress(e.tag)) tableAddrs.push_back(e.val);
+    std::uint64_t moveAlign = 1;
+    std::optional<std::uint64_t> interpOff;
+    for (std::uint64_t i = 0; i < phnum; ++i) {
+        const std::uint64_t type = ph(i, 0, 4);
+        if (type == PT_LOAD || type == PT_PHDR || !isMoved(ph(i, L.phOffset(), word), ph(i, L.phFilesz(), word))) continue;
+        if (type == PT_INTERP) interpOff = ph(i, L.phOffset(), word);
+        else if (type != PT_NOTE && type != PT_GNU_PROPERTY) return false;
+        moveAlign = std::max(moveAlign, ph(i, L.phAlign(), word));
+    }
+    for (std::uint64_t i = 1; i < shnum; ++i) {
+        const std::uint64_t type = sh(i, L.shType(), 4);
+        const std::uint64_t off = sh(i, L.shOffset(), word);
+        if (type == SHT_NOBITS || !isMoved(off, sh(i, L.shSize(), word))) continue;
+        const std::uint64_t addr = sh(i, L.shAddr(), word);
+        const bool isTable = std::find(tableAddrs.begin(), tableAddrs.end(), addr) != tableAddrs.end();
+        if (addr != off + loadBias || (type != SHT_NOTE && off != interpOff && !isTable)) return false;
+        moveAlign = std::max(moveAlign, sh(i, L.shAlign(), word));
+    }
+    if (moveAlign > pageAlign) return false;
+
+    // A DT_RUNPATH entry to add goes into a spare DT_NULL slot if the linker left one.
+    const std::uint64_t slots = v.dyn.filesz / entSize;
+    const bool addEntry = v.target == nullptr;
+    const bool moveDynamic = addEntry && slots < v.entries.size() + 2;
+
+    const std::uint64_t movedRel = moveBegin % moveAlign; // keeps every moved address as aligned as before
+    const std::uint64_t dynRel = alignUp(movedRel + (moveEnd - moveBegin), word);
+    const std::uint64_t dynBytes = moveDynamic ? (v.entries.size() + 2) * entSize : 0;
+    const std::uint64_t strRel = dynRel + dynBytes;
+    const std::uint64_t runpathRel = v.strsz;
+    const std::uint64_t newStrsz = v.strsz + runpath.size() + 1;
+    const std::uint64_t segBytes = strRel + newStrsz;
+
+    std::uint64_t segOff = alignUp(obj.size(), pageAlign);
+    if (segOff + *bias < alignUp(maxEnd, pageAlign)) segOff = alignUp(maxEnd, pageAlign) - *bias;
+    const std::uint64_t segAddr = segOff + *bias;
+    if (!v.is64 && segAddr + segBytes > 0xFFFFFFFFull) return false;
+    auto movedTo = [&](std::uint64_t off) { return segOff + movedRel + (off - moveBegin); };
+
+    std::vector<std::uint8_t> seg(static_cast<std::size_t>(segBytes), 0);
+    std::memcpy(seg.data() + movedRel, obj.data() + moveBegin, static_cast<std::size_t>(moveEnd - moveBegin));
+
+    // Program headers: PT_PHDR grows, moved segments follow their contents; the new PT_LOAD goes right
+    // after the last one, keeping PT_LOADs sorted by address.
+    auto setPh = [&](std::uint8_t* p, std::uint64_t off, std::uint64_t size) {
+        putInt(p + L.phOffset(), off, word, v.be);
+        putInt(p + L.phVaddr(), off + *bias, word, v.be);
+        putInt(p + L.phPaddr(), off + *bias, word, v.be);
+        putInt(p + L.phFilesz(), size, word, v.be);
+        putInt(p + L.phMemsz(), size, word, v.be);
+    };
+    std::vector<std::uint8_t> phdrs(static_cast<std::size_t>(grownEnd - phoff));
+    std::uint8_t* out = phdrs.data();
+    for (std::uint64_t i = 0; i < phnum; ++i) {
+        std::uint8_t* p = out;
+        std::memcpy(p, obj.data() + phoff + i * phentsize, static_cast<std::size_t>(phentsize));
+        out += phentsize;
+        const std::uint64_t type = ph(i, 0, 4);
+        const std::uint64_t off = ph(i, L.phOffset(), word);
+        const std::uint64_t filesz = ph(i, L.phFilesz(), word);
+        if (type == PT_PHDR) {
+            putInt(p + L.phFilesz(), grownEnd - phoff, word, v.be);
+            putInt(p + L.phMemsz(), grownEnd - phoff, word, v.be);
+        } else if (type == PT_DYNAMIC && moveDynamic) {
+            setPh(p, segOff + dynRel, dynBytes);
+        } else if (type != PT_LOAD && isMoved(off, filesz)) {
+            setPh(p, movedTo(off), filesz);
+        }
+        if (i == lastLoad) {
+            std::uint8_t* load = out;
+            out += phentsize;
+            std::memset(load, 0, static_cast<std::size_t>(phentsize));
+            putInt(load, PT_LOAD, 4, v.be);
+            putInt(load + L.phFlags(), PF_R | (moveDynamic ? PF_W : 0), 4, v.be); // ld.so may write to .dynamic
+            setPh(load, segOff, segBytes);
+            putInt(load + L.phAlign(), pageAlign, word, v.be);
+        }
+    }
+
+    // .dynstr: the old table unchanged (every existing offset into it stays valid), then the new value.
+    std::memcpy(seg.data() + strRel, obj.data() + v.strtabOff, static_cast<std::size_t>(v.strsz));
+    std::memcpy(seg.data() + strRel + runpathRel, runpath.data(), runpath.size());
+
+    // .dynamic entries whose values change, written in place or into the moved copy.
+    auto newValue = [&](const DynEntry& e) -> std::optional<std::uint64_t> {
+        if (e.tag == DT_STRTAB) return segAddr + strRel;
+        if (e.tag == DT_STRSZ) return newStrsz;
+        if (&e == v.target) return runpathRel;
+        if (isTableAddress(e.tag) && e.val >= moveBegin + loadBias && e.val < moveEnd + loadBias) {
+            return movedTo(e.val - loadBias) + *bias;
+        }
+        return std::nullopt;
+    };
+    if (moveDynamic) {
+        std::uint8_t* d = seg.data() + dynRel;
+        for (const auto& e : v.entries) {
+            putInt(d, e.tag, word, v.be);
+            putInt(d + word, newValue(e).value_or(e.val), word, v.be);
+            d += entSize;
+        }
+        putInt(d, DT_RUNPATH, word, v.be);
+        putInt(d + word, runpathRel, word, v.be); // followed by the zeroed DT_NULL
+    } else {
+        for (const auto& e : v.entries) {
+            if (&e == v.target && e.tag != DT_RUNPATH) patches.push_back({e.fileOffset, encodeWord(DT_RUNPATH, v.is64, v.be)});
+            if (auto nv = newValue(e)) patches.push_back({e.fileOffset + word, encodeWord(*nv, v.is64, v.be)});
+        }
+        if (addEntry) {
+            std::vector<std::uint8_t> added(static_cast<std::size_t>(2 * entSize), 0);
+            putInt(added.data(), DT_RUNPATH, word, v.be);
+            putInt(added.data() + word, runpathRel, word, v.be);
+            patches.push_back({v.dyn.offset + v.entries.size() * entSize, std::move(added)});
+        }
+    }
+    patches.push_back({segOff, std::move(seg)});
+    patches.push_back({phoff, std::move(phdrs)});
+    patches.push_back({L.phnum(), encodeInt(phnum + 1, 2, v.be)});
+
+    // Section headers follow everything that moved, so objcopy and strip lay the file out the same way.
+    std::vector<std::uint8_t> shdrs(obj.data() + shoff, obj.data() + shoff + shentsize * shnum);
+    auto place = [&](std::uint64_t i, std::uint64_t off, std::uint64_t size) {
+        std::uint8_t* h = shdrs.data() + i * shentsize;
+        putInt(h + L.shAddr(), off + *bias, word, v.be);
+        putInt(h + L.shOffset(), off, word, v.be);
+        putInt(h + L.shSize(), size, word, v.be);
+    };
+    for (std::uint64_t i = 1; i < shnum; ++i) {
+        const std::uint64_t type = sh(i, L.shType(), 4);
+        const std::uint64_t off = sh(i, L.shOffset(), word);
+        const std::uint64_t size = sh(i, L.shSize(), word);
+        if (type == SHT_STRTAB && off == v.strtabOff) place(i, segOff + strRel, newStrsz);
+        else if (type == SHT_DYNAMIC && moveDynamic && off == v.dyn.offset) place(i, segOff + dynRel, dynBytes);
+        else if (type != SHT_NOBITS && isMoved(off, size)) place(i, movedTo(off), size);
+    }
+    return sortSectionHeaders(obj, L, v.be, shoff, shdrs, patches);
+}
+
+} // namespace
+
+RunpathEdit setElfRunpath(const fs::path& p, const std::string& runpath) {
+    std::vector<FilePatch> patches;
+    RunpathEdit result = RunpathEdit::Patched;
+    {
+        auto obj = ObjectFile::open(p);
+        if (!obj || obj->type() != BinaryType::ELF) return RunpathEdit::Failed;
+        const bool is64 = obj->is64();
+        const bool be = obj->bigEndian();
+
+        std::vector<ElfSegment> loads;
+        std::optional<ElfSegment> dyn;
+        for (const auto& s : obj->elfSegments()) {
+            if (s.type == PT_LOAD) loads.push_back(s);
+            else if (s.type == PT_DYNAMIC) dyn = s;
+        }
+        if (!dyn || !obj->inBounds(dyn->offset, dyn->filesz)) return RunpathEdit::Failed;
+
+        const std::uint64_t entSize = is64 ? 16 : 8;
+        std::vector<DynEntry> entries;
+        std::optional<std::uint64_t> strtabVa;
+        std::uint64_t strsz = 0;
+        for (std::uint64_t off = 0; off + entSize <= dyn->filesz; off += entSize) {
+            const std::uint64_t at = dyn->offset + off;
+            DynEntry e{at, is64 ? obj->u64(at) : obj->u32(at), is64 ? obj->u64(at + 8) : obj->u32(at + 4)};
+            if (e.tag == DT_NULL) break;
+            if (e.tag == DT_STRTAB) strtabVa = e.val;
+            else if (e.tag == DT_STRSZ) strsz = e.val;
+            entries.push_back(e);
+        }
+        if (!strtabVa) return RunpathEdit::Failed;
+        std::optional<std::uint64_t> strtabOff;
+        for (const auto& s : loads) {
+            if (*strtabVa >= s.vaddr && *strtabVa - s.vaddr < s.filesz) { strtabOff = s.offset + (*strtabVa - s.vaddr); break; }
+        }
+        if (!strtabOff || !obj->inBounds(*strtabOff, strsz) || strsz == 0) return RunpathEdit::Failed;
+
+        auto strLenAt = [&](std::uint64_t rel) -> std::optional<std::uint64_t> {
+            if (rel >= strsz) return std::nullopt;
+            const char* s = reinterpret_cast<const char*>(obj->data() + *strtabOff + rel);
+            const std::uint64_t maxLen = strsz - rel;
+            std::uint64_t n = 0;
+            while (n < maxLen && s[n] != '\0') ++n;
+            if (n == maxLen) return std::nullopt;
+            return n;
+        };
+
+        // Prefer an existing DT_RUNPATH; a DT_RPATH entry is retagged, as patchelf does by default.
+        const DynEntry* target = nullptr;
+        for (const auto& e : entries) if (e.tag == DT_RUNPATH) { target = &e; break; }
+        if (!target) for (const auto& e : entries) if (e.tag == DT_RPATH) { target = &e; break; }
+
+        // The old string is overwritten when the new value fits and no other entry points into it (the
+        // linker may tail-merge strings); otherwise .dynstr grows.
+        bool inPlace = false;
+        if (target) {
+            auto oldLen = strLenAt(target->val);
+            if (!oldLen) return RunpathEdit::Failed;
+            const char* oldStr = reinterpret_cast<const char*>(obj->data() + *strtabOff + target->val);
+            if (target->tag == DT_RUNPATH && *oldLen == runpath.size() && std::memcmp(oldStr, runpath.data(), runpath.size()) == 0) {
+                return RunpathEdit::Unchanged;
+            }
+            inPlace = runpath.size() <= *oldLen;
+            for (const auto& e : entries) {
+                if (&e == target) continue;
+                if (e.tag != DT_NEEDED && e.tag != DT_SONAME && e.tag != DT_RPATH && e.tag != DT_RUNPATH) continue;
+                if (e.val > target->val && e.val <= target->val + *oldLen) inPlace = false;
+            }
+            if (inPlace) {
+                FilePatch str{*strtabOff + target->val, std::vector<std::uint8_t>(static_cast<std::size_t>(*oldLen), 0)};
+                std::memcpy(str.bytes.data(), runpath.data(), runpath.size());
+                patches.push_back(std::move(str));
+                if (target->tag != DT_RUNPATH) patches.push_back({target->fileOffset, encodeWord(DT_RUNPATH, is64, be)});
+            }
+        }
+        if (!inPlace) {
+            const DynamicView view{*obj, is64, be, *dyn, entries, *strtabOff, strsz, target};
+            if (!relocateDynstr(view, runpath, patches)) return RunpathEdit::NoRoom;
+            result = RunpathEdit::Relocated;
+        }
+    }
+    return writeFilePatches(p, patches) ? result : RunpathEdit::Failed;
+}
+
+} // namespace cdqt
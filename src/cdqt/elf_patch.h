@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+#include "common.h"
+
+namespace cdqt {
+
+enum class RunpathEdit {
+    Unchanged, // DT_RUNPATH already had the requested value
+    Patched,   // rewritten in place
+    Relocated, // .dynstr (and if needed .dynamic) moved into a new segment at the end of the file
+    NoRoom,    // .dynstr would have to grow, but the segment layout does not allow adding one
+    Failed     // not an ELF image with a dynamic section, or the write failed
+};
+
+// Sets DT_RUNPATH like `patchelf --set-rpath`, converting an existing DT_RPATH entry or adding one. The
+// new value is written over the old string in .dynstr when it fits; otherwise .dynstr is extended in a
+// new PT_LOAD segment appended to the file. Only the touched bytes are rewritten.
+RunpathEdit setElfRunpath(const fs::path& p, const std::string& runpath);
+
+} // namespace cdqt
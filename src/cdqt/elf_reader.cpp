@@ -0,0 +1,108 @@
+#include "elf_reader.h"
+
+#include <cstdint>
+
+#include "util.h"
+
+namespace cdqt {
+
+namespace {
+
+constexpr std::uint64_t EI_NIDENT = 16;
+
+constexpr std::uint32_t PT_LOAD = 1;
+constexpr std::uint32_t PT_DYNAMIC = 2;
+
+constexpr std::uint64_t DT_NULL = 0;
+constexpr std::uint64_t DT_NEEDED = 1;
+constexpr std::uint64_t DT_STRTAB = 5;
+constexpr std::uint64_t DT_STRSZ = 10;
+constexpr std::uint64_t DT_SONAME = 14;
+constexpr std::uint64_t DT_RPATH = 15;
+constexpr std::uint64_t DT_RUNPATH = 29;
+
+} // namespace
+
+std::optional<ElfDynamicInfo> readElfDynamic(const ObjectFile& obj) {
+    if (obj.type() != BinaryType::ELF) return std::nullopt;
+    const std::uint8_t* d = obj.data();
+    const bool is64 = obj.is64();
+    const bool be = obj.bigEndian();
+    if (!obj.inBounds(0, EI_NIDENT)) return std::nullopt;
+    if ((d[4] != 1 && d[4] != 2) || (d[5] != 1 && d[5] != 2)) return std::nullopt;
+    if (!obj.inBounds(0, is64 ? 64 : 52)) return std::nullopt;
+
+    const auto segments = obj.elfSegments();
+    if (segments.empty()) return std::nullopt;
+    std::vector<ElfSegment> loads;
+    std::optional<ElfSegment> dyn;
+    for (const auto& s : segments) {
+        if (s.type == PT_LOAD) loads.push_back(s);
+        else if (s.type == PT_DYNAMIC) dyn = s;
+    }
+
+    ElfDynamicInfo info;
+    if (!dyn) return info; // statically linked: nothing to resolve
+    if (!obj.inBounds(dyn->offset, dyn->filesz)) return std::nullopt;
+
+    // Dynamic entries reference the string table by virtual address; map it back through PT_LOAD,
+    // ignoring segments whose file contents lie (partly) outside a truncated or malformed file.
+    auto vaddrToOffset = [&](std::uint64_t va) -> std::optional<std::uint64_t> {
+        for (const auto& s : loads) {
+            if (!obj.inBounds(s.offset, s.filesz)) continue;
+            if (va >= s.vaddr && va - s.vaddr < s.filesz) return s.offset + (va - s.vaddr);
+        }
+        return std::nullopt;
+    };
+
+    const std::uint64_t entSize = is64 ? 16 : 8;
+    std::uint64_t strtabVa = 0, strsz = 0;
+    bool haveStrtab = false;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> stringEntries; // (tag, string offset)
+    for (std::uint64_t off = 0; off + entSize <= dyn->filesz; off += entSize) {
+        const std::uint8_t* e = d + dyn->offset + off;
+        const std::uint64_t tag = is64 ? readU64(e, be) : readU32(e, be);
+        const std::uint64_t val = is64 ? readU64(e + 8, be) : readU32(e + 4, be);
+        if (tag == DT_NULL) break;
+        switch (tag) {
+            case DT_STRTAB: strtabVa = val; haveStrtab = true; break;
+            case DT_STRSZ: strsz = val; break;
+            case DT_NEEDED: case DT_SONAME: case DT_RPATH: case DT_RUNPATH:
+                stringEntries.emplace_back(tag, val);
+                break;
+            default: break;
+        }
+    }
+    if (stringEntries.empty()) return info;
+    if (!haveStrtab) return std::nullopt;
+    auto strtabOff = vaddrToOffset(strtabVa);
+    if (!strtabOff || *strtabOff >= obj.size()) return std::nullopt;
+    if (strsz == 0 || !obj.inBounds(*strtabOff, strsz)) strsz = obj.size() - *strtabOff;
+
+    auto stringAt = [&](std::uint64_t rel) -> std::optional<std::string> {
+        if (rel >= strsz) return std::nullopt;
+        const char* s = reinterpret_cast<const char*>(d + *strtabOff + rel);
+        std::uint64_t n = 0;
+        const std::uint64_t maxLen = strsz - rel;
+        while (n < maxLen && s[n] != '\0') ++n;
+        if (n == maxLen) return std::nullopt;
+        return std::string(s, static_cast<size_t>(n));
+    };
+
+    for (const auto& [tag, rel] : stringEntries) {
+        auto s = stringAt(rel);
+        if (!s) return std::nullopt;
+        if (tag == DT_NEEDED) {
+            if (!s->empty()) info.needed.push_back(*s);
+        } else if (tag == DT_SONAME) {
+            if (!s->empty()) info.soname = *s;
+        } else if (tag == DT_RPATH) {
+            for (const auto& part : splitPaths(*s, ':')) info.rpath.push_back(part);
+        } else {
+            for (const auto& part : splitPaths(*s, ':')) info.runpath.push_back(part);
+        }
+    }
+    return info;
+}
+
+} // namespace cdqt
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "object_file.h"
+
+namespace cdqt {
+
+// Entries of the ELF dynamic section that matter for dependency resolution, in file order.
+struct ElfDynamicInfo {
+    std::vector<std::string> needed;
+    std::vector<std::string> rpath;   // DT_RPATH, split on ':'
+    std::vector<std::string> runpath; // DT_RUNPATH, split on ':'
+    std::optional<std::string> soname;
+};
+
+// Reads PT_DYNAMIC of an ELF32/ELF64 file (either endianness) in one pass over the mapped file.
+// Returns nullopt when the file is not a well-formed ELF image; callers may then fall back to objdump.
+std::optional<ElfDynamicInfo> readElfDynamic(const ObjectFile& obj);
+
+} // namespace cdqt
@@ -2,9 +2,22 @@
 
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include "util.h"
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
 namespace cdqt {
 
 void ensureOutputLayout(const DeployPlan& plan) {
@@ -47,35 +60,79 @@ void ensureOutputLayout(const DeployPlan& plan) {
     }
 }
 
+// Size of a copy source. Nix store files never change, so their size is looked up once per process.
+static std::uintmax_t sourceSize(const fs::path& from, std::error_code& ec) {
+    if (!isNixStorePath(from)) return fs::file_size(from, ec);
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::uintmax_t> sizes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = sizes.find(from.native());
+        if (it != sizes.end()) return it->second;
+    }
+    const std::uintmax_t size = fs::file_size(from, ec);
+    if (!ec) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sizes.emplace(from.native(), size);
+    }
+    return size;
+}
+
 bool copyFileOverwrite(const fs::path& from, const fs::path& to) {
     std::error_code ec;
     fs::create_directories(to.parent_path(), ec);
     ec.clear();
 
-    // Skip if destination exists with same size and timestamp newer-or-equal to source
+    // Skip if destination exists with same size and timestamp newer-or-equal to source. Store files
+    // all carry the epoch timestamp, so for them the size check alone decides.
     std::error_code se1, se2;
     auto dstStatus = fs::status(to, se2);
     if (!se2 && fs::exists(to) && fs::is_regular_file(dstStatus)) {
         std::error_code te1, te2;
-        auto srcSize = fs::file_size(from, te1);
+        auto srcSize = sourceSize(from, te1);
         auto dstSize = fs::file_size(to, te2);
         std::error_code le1, le2;
-        auto srcTime = fs::last_write_time(from, le1);
+        const bool immutableSrc = isNixStorePath(from);
+        auto srcTime = immutableSrc ? fs::file_time_type::min() : fs::last_write_time(from, le1);
         auto dstTime = fs::last_write_time(to, le2);
         if (!te1 && !te2 && !le1 && !le2 && srcSize == dstSize && dstTime >= srcTime) {
-            if (isVerbose()) std::cout << "[copy-skip] " << from << " -> " << to << "\n";
+            if (isVerbose()) logLine("[copy-skip] ", from, " -> ", to);
             return true;
         }
     }
 
     bool ok = fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
-    if (!ok && isVerbose()) std::cout << "[copy-fail] " << from << " -> " << to << ": " << ec.message() << "\n";
+    if (!ok && isVerbose()) logLine("[copy-fail] ", from, " -> ", to, ": ", ec.message());
     // Ensure destination is owner-writable so we can patch rpaths later
     std::error_code pec;
     fs::permissions(to, fs::perms::owner_write, fs::perm_options::add, pec);
     return ok;
 }
 
+bool cloneOrCopyFile(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::create_directories(to.parent_path(), ec);
+#if defined(__linux__) && defined(FICLONE)
+    int src = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src >= 0) {
+        struct stat st {};
+        const mode_t mode = ::fstat(src, &st) == 0 ? (st.st_mode & 0777) | S_IWUSR : 0644;
+        int dst = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+        const bool cloned = dst >= 0 && ::ioctl(dst, FICLONE, src) == 0;
+        if (dst >= 0) ::close(dst);
+        ::close(src);
+        if (cloned) return true;
+    }
+#elif defined(__APPLE__)
+    fs::remove(to, ec);
+    if (::clonefile(from.c_str(), to.c_str(), 0) == 0) return true;
+#endif
+    ec.clear();
+    bool ok = fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    if (!ok && isVerbose()) logLine("[copy-fail] ", from, " -> ", to, ": ", ec.message());
+    return ok;
+}
+
 void mergeDirectoryTree(const fs::path& srcRoot, const fs::path& dstRoot) {
     std::error_code ec;
     if (srcRoot.empty() || dstRoot.empty()) return;
@@ -12,6 +12,10 @@ void ensureOutputLayout(const DeployPlan& plan);
 
 bool copyFileOverwrite(const fs::path& from, const fs::path& to);
 
+// Replaces `to` with a copy of `from`, as a reflink sharing the source's blocks where the filesystem
+// supports it (FICLONE on Linux, clonefile on macOS) and a plain copy otherwise.
+bool cloneOrCopyFile(const fs::path& from, const fs::path& to);
+
 void mergeDirectoryTree(const fs::path& srcRoot, const fs::path& dstRoot);
 void applyOverlays(const DeployPlan& plan);
 
@@ -0,0 +1,214 @@
+#include "macho_edit.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "deps_parse.h"
+#include "mapped_file.h"
+#include "object_file.h"
+#include "util.h"
+
+namespace cdqt {
+
+namespace {
+
+constexpr std::uint32_t MH_MAGIC = 0xFEEDFACE;
+constexpr std::uint32_t MH_MAGIC_64 = 0xFEEDFACF;
+
+constexpr std::uint32_t LC_REQ_DYLD = 0x80000000;
+constexpr std::uint32_t LC_SEGMENT = 0x1;
+constexpr std::uint32_t LC_LOAD_DYLIB = 0xC;
+constexpr std::uint32_t LC_ID_DYLIB = 0xD;
+constexpr std::uint32_t LC_SEGMENT_64 = 0x19;
+constexpr std::uint32_t LC_LOAD_WEAK_DYLIB = 0x18 | LC_REQ_DYLD;
+constexpr std::uint32_t LC_RPATH = 0x1C | LC_REQ_DYLD;
+constexpr std::uint32_t LC_REEXPORT_DYLIB = 0x1F | LC_REQ_DYLD;
+constexpr std::uint32_t LC_LAZY_LOAD_DYLIB = 0x20;
+constexpr std::uint32_t LC_LOAD_UPWARD_DYLIB = 0x23 | LC_REQ_DYLD;
+
+bool isDylibLoad(std::uint32_t cmd) {
+    return cmd == LC_LOAD_DYLIB || cmd == LC_LOAD_WEAK_DYLIB || cmd == LC_REEXPORT_DYLIB ||
+           cmd == LC_LAZY_LOAD_DYLIB || cmd == LC_LOAD_UPWARD_DYLIB;
+}
+
+void putU32(std::vector<std::uint8_t>& buf, std::size_t at, std::uint32_t v, bool be) {
+    for (std::size_t i = 0; i < 4; ++i) {
+        const std::size_t shift = 8 * (be ? (3 - i) : i);
+        buf[at + i] = static_cast<std::uint8_t>((v >> shift) & 0xFF);
+    }
+}
+
+// Copies `fixed` bytes of the original command header, then appends the NUL-terminated string and pads
+// the command to the pointer alignment, as ld64 does.
+std::vector<std::uint8_t> buildStringCommand(const std::uint8_t* orig, std::uint32_t fixed, const std::string& s,
+                                             bool is64, bool be) {
+    const std::size_t align = is64 ? 8 : 4;
+    std::size_t size = fixed + s.size() + 1;
+    size = (size + align - 1) / align * align;
+    std::vector<std::uint8_t> out(size, 0);
+    std::memcpy(out.data(), orig, fixed);
+    std::memcpy(out.data() + fixed, s.data(), s.size());
+    putU32(out, 4, static_cast<std::uint32_t>(size), be);
+    putU32(out, 8, fixed, be);
+    return out;
+}
+
+std::optional<std::string> commandString(const std::uint8_t* c, std::uint32_t cmdsize, bool be) {
+    if (cmdsize < 12) return std::nullopt;
+    const std::uint32_t off = readU32(c + 8, be);
+    if (off >= cmdsize) return std::nullopt;
+    const char* s = reinterpret_cast<const char*>(c + off);
+    std::uint32_t n = 0;
+    while (off + n < cmdsize && s[n] != '\0') ++n;
+    return std::string(s, n);
+}
+
+enum class SliceEdit { Unchanged, Patched, NoRoom, Failed };
+
+// Plans the rewrite of one thin image starting at `base`; appends the resulting patch on success.
+SliceEdit planSlice(const ObjectFile& obj, std::uint64_t base, std::uint64_t limit, const MachOEdits& edits,
+                    std::vector<FilePatch>& patches) {
+    if (limit - base < 28) return SliceEdit::Failed;
+    const std::uint8_t* h = obj.data() + base;
+    bool be = false;
+    std::uint32_t magic = readU32(h, false);
+    if (magic != MH_MAGIC && magic != MH_MAGIC_64) {
+        magic = readU32(h, true);
+        if (magic != MH_MAGIC && magic != MH_MAGIC_64) return SliceEdit::Failed;
+        be = true;
+    }
+    const bool is64 = magic == MH_MAGIC_64;
+    const std::uint64_t headerSize = is64 ? 32 : 28;
+    const std::uint32_t ncmds = readU32(h + 16, be);
+    const std::uint32_t sizeofcmds = readU32(h + 20, be);
+    if (headerSize + sizeofcmds > limit - base) return SliceEdit::Failed;
+
+    // Load commands may grow up to the first byte of section data.
+    std::uint64_t room = limit - base;
+    std::vector<std::vector<std::uint8_t>> cmds;
+    std::vector<std::string> existingRpaths;
+    bool changed = false;
+    std::uint64_t off = headerSize;
+    for (std::uint32_t i = 0; i < ncmds; ++i) {
+        if (off + 8 > headerSize + sizeofcmds) return SliceEdit::Failed;
+        const std::uint8_t* c = h + off;
+        const std::uint32_t cmd = readU32(c, be);
+        const std::uint32_t cmdsize = readU32(c + 4, be);
+        if (cmdsize < 8 || off + cmdsize > headerSize + sizeofcmds) return SliceEdit::Failed;
+        off += cmdsize;
+
+        if (cmd == LC_SEGMENT || cmd == LC_SEGMENT_64) {
+            const std::uint32_t segHdr = is64 ? 72 : 56;
+            const std::uint32_t secSize = is64 ? 80 : 68;
+            if (cmdsize >= segHdr) {
+                const std::uint32_t nsects = readU32(c + (is64 ? 64 : 48), be);
+                for (std::uint32_t s = 0; s < nsects && segHdr + (s + 1) * secSize <= cmdsize; ++s) {
+                    const std::uint8_t* sec = c + segHdr + s * secSize;
+                    const std::uint64_t secSizeBytes = is64 ? readU64(sec + 40, be) : readU32(sec + 36, be);
+                    const std::uint32_t secOff = readU32(sec + (is64 ? 48 : 40), be);
+                    if (secOff != 0 && secSizeBytes != 0) room = std::min<std::uint64_t>(room, secOff);
+                }
+            }
+        }
+
+        if (cmd == LC_ID_DYLIB && edits.id) {
+            auto cur = commandString(c, cmdsize, be);
+            if (cur && *cur != *edits.id) {
+                cmds.push_back(buildStringCommand(c, 24, *edits.id, is64, be));
+                changed = true;
+                continue;
+            }
+        } else if (isDylibLoad(cmd) && !edits.changes.empty()) {
+            auto cur = commandString(c, cmdsize, be);
+            auto it = cur ? std::find_if(edits.changes.begin(), edits.changes.end(),
+                                         [&](const auto& ch){ return ch.first == *cur; })
+                          : edits.changes.end();
+            if (it != edits.changes.end() && it->second != *cur) {
+                cmds.push_back(buildStringCommand(c, 24, it->second, is64, be));
+                changed = true;
+                continue;
+            }
+        } else if (cmd == LC_RPATH) {
+            auto cur = commandString(c, cmdsize, be);
+            if (cur && std::find(edits.deleteRpaths.begin(), edits.deleteRpaths.end(), *cur) != edits.deleteRpaths.end()) {
+                changed = true;
+                continue;
+            }
+            if (cur) existingRpaths.push_back(*cur);
+        }
+        cmds.emplace_back(c, c + cmdsize);
+    }
+
+    for (const auto& rp : edits.addRpaths) {
+        if (std::find(existingRpaths.begin(), existingRpaths.end(), rp) != existingRpaths.end()) continue;
+        std::vector<std::uint8_t> rpathHdr(12, 0);
+        putU32(rpathHdr, 0, LC_RPATH, be);
+        cmds.push_back(buildStringCommand(rpathHdr.data(), 12, rp, is64, be));
+        existingRpaths.push_back(rp);
+        changed = true;
+    }
+    if (!changed) return SliceEdit::Unchanged;
+
+    std::uint64_t newSize = 0;
+    for (const auto& c : cmds) newSize += c.size();
+    if (headerSize + newSize > room) return SliceEdit::NoRoom;
+
+    // One contiguous write: ncmds, sizeofcmds, then the command block, zero-filling what it no longer covers.
+    const std::uint64_t span = std::max<std::uint64_t>(newSize, sizeofcmds);
+    FilePatch patch{base + 16, std::vector<std::uint8_t>(static_cast<std::size_t>(8 + (headerSize - 24) + span), 0)};
+    putU32(patch.bytes, 0, static_cast<std::uint32_t>(cmds.size()), be);
+    putU32(patch.bytes, 4, static_cast<std::uint32_t>(newSize), be);
+    std::memcpy(patch.bytes.data() + 8, h + 24, static_cast<std::size_t>(headerSize - 24)); // flags (+ reserved)
+    std::size_t at = static_cast<std::size_t>(8 + (headerSize - 24));
+    for (const auto& c : cmds) {
+        std::memcpy(patch.bytes.data() + at, c.data(), c.size());
+        at += c.size();
+    }
+    patches.push_back(std::move(patch));
+    return SliceEdit::Patched;
+}
+
+} // namespace
+
+MachOEditResult editMachOLoadCommands(const fs::path& p, const MachOEdits& edits) {
+    if (edits.empty()) return MachOEditResult::Unchanged;
+    std::vector<FilePatch> patches;
+    {
+        auto obj = ObjectFile::open(p);
+        if (!obj || obj->type() != BinaryType::MACHO || obj->machoSlices().empty()) return MachOEditResult::Failed;
+        for (const auto& slice : obj->machoSlices()) {
+            switch (planSlice(*obj, slice.offset, slice.offset + slice.size, edits, patches)) {
+                case SliceEdit::Unchanged: case SliceEdit::Patched: break;
+                case SliceEdit::NoRoom: return MachOEditResult::NoRoom;
+                case SliceEdit::Failed: return MachOEditResult::Failed;
+            }
+        }
+    }
+    if (patches.empty()) return MachOEditResult::Unchanged;
+    return writeFilePatches(p, patches) ? MachOEditResult::Patched : MachOEditResult::Failed;
+}
+
+bool applyMachOEdits(const fs::path& p, const MachOEdits& edits) {
+    switch (editMachOLoadCommands(p, edits)) {
+        case MachOEditResult::Unchanged: case MachOEditResult::Patched: return true;
+        case MachOEditResult::NoRoom: case MachOEditResult::Failed: break;
+    }
+    if (isVerbose()) logLine("[macho-edit] falling back to llvm-install-name-tool for ", p);
+    std::vector<std::string> argv{"llvm-install-name-tool"};
+    if (edits.id) argv.insert(argv.end(), {"-id", *edits.id});
+    for (const auto& [from, to] : edits.changes) argv.insert(argv.end(), {"-change", from, to});
+    for (const auto& rp : edits.deleteRpaths) argv.insert(argv.end(), {"-delete_rpath", rp});
+    // Unlike the native editor, the tool refuses to add an rpath that already exists.
+    const auto existing = parseMachO(p).rpaths;
+    for (const auto& rp : edits.addRpaths) {
+        if (std::find(existing.begin(), existing.end(), rp) == existing.end()) argv.insert(argv.end(), {"-add_rpath", rp});
+    }
+    argv.push_back(p.string());
+    const ProcessResult res = runProcess(argv);
+    if (res.exitCode != 0 && !res.err.empty()) std::cerr << res.err;
+    return res.exitCode == 0;
+}
+
+} // namespace cdqt
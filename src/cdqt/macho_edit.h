@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+
+namespace cdqt {
+
+// A batch of install-name-tool style edits for one Mach-O file.
+struct MachOEdits {
+    std::optional<std::string> id;                            // -id
+    std::vector<std::pair<std::string, std::string>> changes; // -change old new
+    std::vector<std::string> addRpaths;                       // -add_rpath (skipped if present)
+    std::vector<std::string> deleteRpaths;                    // -delete_rpath
+
+    bool empty() const { return !id && changes.empty() && addRpaths.empty() && deleteRpaths.empty(); }
+};
+
+enum class MachOEditResult {
+    Unchanged, // nothing to do; file untouched
+    Patched,   // load commands rewritten in place
+    NoRoom,    // the new load commands do not fit into the header padding
+    Failed     // not a Mach-O image, or the write failed
+};
+
+// Rebuilds the load commands of every slice with all edits applied and writes them back in one pass,
+// using the padding between the load commands and the first section.
+MachOEditResult editMachOLoadCommands(const fs::path& p, const MachOEdits& edits);
+
+// editMachOLoadCommands, falling back to a single llvm-install-name-tool call carrying every edit
+// when the header padding is too small.
+bool applyMachOEdits(const fs::path& p, const MachOEdits& edits);
+
+} // namespace cdqt
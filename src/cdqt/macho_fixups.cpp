@@ -2,11 +2,13 @@
 
 #include <algorithm>
 #include <cctype>
+#include <iostream>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "deps_parse.h"
+#include "macho_edit.h"
 #include "util.h"
 
 namespace cdqt {
@@ -105,32 +107,38 @@ void fixInstallNamesMachO(const DeployPlan& plan) {
         }
     }
 
-    std::sort(bins.begin(), bins.end());
-    bins.erase(std::unique(bins.begin(), bins.end()), bins.end());
-
-    for (const auto& b : bins) {
-        if (pathStartsWith(b, fwDir)) {
-            std::string newId = frameworkInstallNameFromPath(b, bundle);
-            int code = 0;
-            std::string cmd = std::string("llvm-install-name-tool -id ") + shellEscape(newId) + " " + shellEscape(b.string());
-            runCommand(cmd, code);
-        }
+    // A dylib symlink and its target are one file: edit it once, so no two jobs rewrite it at the same
+    // time. Of its names, the one sorting last is kept; its ID is the one that won when these edits ran
+    // one after another.
+    std::vector<std::pair<fs::path, fs::path>> files; // (canonical path, path as found)
+    for (const auto& b : bins) files.emplace_back(canonicalPath(b), b);
+    std::sort(files.begin(), files.end());
+    bins.clear();
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (i + 1 < files.size() && files[i + 1].first == files[i].first) continue;
+        bins.push_back(files[i].second);
     }
 
+    // One batch of edits per binary: its own ID plus every reference into the bundle's Frameworks.
+    // Binaries are independent, so they are edited (or handed to the tool) concurrently.
+    JobPool pool(plan.jobs);
     for (const auto& b : bins) {
-        auto pr = parseOtoolDepsWithId(b);
-        for (const auto& dep : pr.second) {
-            fs::path depPath(dep);
-            if (pathStartsWith(depPath, fwDir)) {
-                std::string newRef = frameworkInstallNameFromPath(depPath, bundle);
-                int code = 0;
-                std::string cmd = std::string("llvm-install-name-tool -change ") + shellEscape(dep) + " " + shellEscape(newRef) + " " + shellEscape(b.string());
-                runCommand(cmd, code);
+        pool.submit([&, b] {
+            MachOEdits edits;
+            if (pathStartsWith(b, fwDir)) edits.id = frameworkInstallNameFromPath(b, bundle);
+            auto pr = parseMachO(b);
+            for (const auto& dep : pr.dependencies) {
+                fs::path depPath(dep);
+                if (pathStartsWith(depPath, fwDir)) {
+                    edits.changes.emplace_back(dep, frameworkInstallNameFromPath(depPath, bundle));
+                }
             }
-        }
+            if (!edits.empty() && !applyMachOEdits(b, edits)) {
+                std::cerr << "Warning: failed to rewrite install names in " + b.string() + "\n";
+            }
+        });
     }
+    pool.wait();
 }
 
 } // namespace cdqt
-
-
@@ -0,0 +1,108 @@
+#include "macho_reader.h"
+
+namespace cdqt {
+
+namespace {
+
+constexpr std::uint32_t MH_MAGIC = 0xFEEDFACE;
+constexpr std::uint32_t MH_MAGIC_64 = 0xFEEDFACF;
+
+constexpr std::uint32_t LC_REQ_DYLD = 0x80000000;
+constexpr std::uint32_t LC_LOAD_DYLIB = 0xC;
+constexpr std::uint32_t LC_ID_DYLIB = 0xD;
+constexpr std::uint32_t LC_LOAD_WEAK_DYLIB = 0x18 | LC_REQ_DYLD;
+constexpr std::uint32_t LC_RPATH = 0x1C | LC_REQ_DYLD;
+constexpr std::uint32_t LC_REEXPORT_DYLIB = 0x1F | LC_REQ_DYLD;
+constexpr std::uint32_t LC_LAZY_LOAD_DYLIB = 0x20;
+constexpr std::uint32_t LC_LOAD_UPWARD_DYLIB = 0x23 | LC_REQ_DYLD;
+
+constexpr std::uint32_t CPU_TYPE_I386 = 7;
+constexpr std::uint32_t CPU_TYPE_ARM = 12;
+constexpr std::uint32_t CPU_TYPE_X86_64 = 0x01000007;
+constexpr std::uint32_t CPU_TYPE_ARM64 = 0x0100000C;
+constexpr std::uint32_t CPU_TYPE_ARM64_32 = 0x0200000C;
+
+} // namespace
+
+std::optional<MachOLoadCommands> readMachOLoadCommands(const ObjectFile& obj, std::uint32_t cpuType) {
+    if (obj.type() != BinaryType::MACHO || obj.machoSlices().empty()) return std::nullopt;
+    const std::uint8_t* d = obj.data();
+
+    // Pick one slice of a fat file and continue as if it were a thin file.
+    const MachOSlice* chosen = &obj.machoSlices().front();
+    if (obj.isFat() && cpuType != 0) {
+        chosen = nullptr;
+        for (const auto& s : obj.machoSlices()) {
+            if (s.cputype == cpuType) { chosen = &s; break; }
+        }
+        if (!chosen) return std::nullopt;
+    }
+    const std::uint64_t base = chosen->offset;
+    const std::uint64_t limit = chosen->offset + chosen->size;
+
+    if (limit - base < 28) return std::nullopt;
+    const std::uint8_t* h = d + base;
+    bool be = false;
+    std::uint32_t magic = readU32(h, false);
+    if (magic != MH_MAGIC && magic != MH_MAGIC_64) {
+        magic = readU32(h, true);
+        if (magic != MH_MAGIC && magic != MH_MAGIC_64) return std::nullopt;
+        be = true;
+    }
+    const std::uint64_t headerSize = magic == MH_MAGIC_64 ? 32 : 28;
+    const std::uint32_t ncmds = readU32(h + 16, be);
+    const std::uint32_t sizeofcmds = readU32(h + 20, be);
+    if (headerSize + sizeofcmds > limit - base) return std::nullopt;
+
+    MachOLoadCommands out;
+    auto lcString = [&](const std::uint8_t* cmd, std::uint32_t cmdsize, std::uint32_t strOffset) -> std::optional<std::string> {
+        if (strOffset >= cmdsize) return std::nullopt;
+        const char* s = reinterpret_cast<const char*>(cmd + strOffset);
+        std::uint32_t n = 0;
+        while (strOffset + n < cmdsize && s[n] != '\0') ++n;
+        if (n == 0) return std::nullopt;
+        return std::string(s, n);
+    };
+
+    std::uint64_t off = headerSize;
+    const std::uint64_t end = headerSize + sizeofcmds;
+    for (std::uint32_t i = 0; i < ncmds; ++i) {
+        if (off + 8 > end) return std::nullopt;
+        const std::uint8_t* c = h + off;
+        const std::uint32_t cmd = readU32(c, be);
+        const std::uint32_t cmdsize = readU32(c + 4, be);
+        if (cmdsize < 8 || off + cmdsize > end) return std::nullopt;
+        switch (cmd) {
+            case LC_ID_DYLIB:
+                if (cmdsize >= 12) out.installName = lcString(c, cmdsize, readU32(c + 8, be));
+                break;
+            case LC_LOAD_DYLIB: case LC_LOAD_WEAK_DYLIB: case LC_REEXPORT_DYLIB:
+            case LC_LAZY_LOAD_DYLIB: case LC_LOAD_UPWARD_DYLIB:
+                if (cmdsize >= 12) {
+                    if (auto s = lcString(c, cmdsize, readU32(c + 8, be))) out.dylibs.push_back(*s);
+                }
+                break;
+            case LC_RPATH:
+                if (cmdsize >= 12) {
+                    if (auto s = lcString(c, cmdsize, readU32(c + 8, be))) out.rpaths.push_back(*s);
+                }
+                break;
+            default: break;
+        }
+        off += cmdsize;
+    }
+    return out;
+}
+
+std::optional<std::string> machOArchName(std::uint32_t cpuType) {
+    switch (cpuType) {
+        case CPU_TYPE_I386: return "i386";
+        case CPU_TYPE_ARM: return "arm";
+        case CPU_TYPE_X86_64: return "x86_64";
+        case CPU_TYPE_ARM64: return "arm64";
+        case CPU_TYPE_ARM64_32: return "arm64_32";
+        default: return std::nullopt;
+    }
+}
+
+} // namespace cdqt
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "object_file.h"
+
+namespace cdqt {
+
+struct MachOLoadCommands {
+    std::optional<std::string> installName; // LC_ID_DYLIB
+    std::vector<std::string> dylibs;        // LC_LOAD_DYLIB, LC_LOAD_WEAK_DYLIB, LC_REEXPORT_DYLIB, ...
+    std::vector<std::string> rpaths;        // LC_RPATH
+};
+
+// Reads the load commands of a thin or fat Mach-O file. For fat files the slice matching cpuType is
+// used; cpuType 0 selects the first slice.
+// Returns nullopt when the file is not a well-formed Mach-O image.
+std::optional<MachOLoadCommands> readMachOLoadCommands(const ObjectFile& obj, std::uint32_t cpuType = 0);
+
+// The architecture name otool and lipo use for `cpuType` (e.g. "arm64"); nullopt if it is not known.
+std::optional<std::string> machOArchName(std::uint32_t cpuType);
+
+} // namespace cdqt
@@ -0,0 +1,108 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cdqt {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    fallback_ = std::move(other.fallback_);
+    mapped_ = other.mapped_;
+    size_ = other.size_;
+    data_ = mapped_ ? other.data_ : fallback_.data();
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.mapped_ = false;
+    return *this;
+}
+
+bool MappedFile::open(const fs::path& p) {
+    close();
+#if !defined(_WIN32)
+    int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* m = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) return false;
+    data_ = static_cast<const std::uint8_t*>(m);
+    size_ = static_cast<std::size_t>(st.st_size);
+    mapped_ = true;
+    return true;
+#else
+    std::ifstream ifs(p, std::ios::binary);
+    if (!ifs) return false;
+    fallback_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    if (fallback_.empty()) return false;
+    data_ = fallback_.data();
+    size_ = fallback_.size();
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#if !defined(_WIN32)
+    if (mapped_ && data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+#endif
+    fallback_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+bool writeFilePatches(const fs::path& p, const std::vector<FilePatch>& patches) {
+    if (patches.empty()) return true;
+#if !defined(_WIN32)
+    int fd = ::open(p.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = true;
+    for (const auto& patch : patches) {
+        const std::uint8_t* src = patch.bytes.data();
+        std::size_t left = patch.bytes.size();
+        off_t off = static_cast<off_t>(patch.offset);
+        while (ok && left > 0) {
+            ssize_t n = ::pwrite(fd, src, left, off);
+            if (n <= 0) { ok = false; break; }
+            src += n;
+            left -= static_cast<std::size_t>(n);
+            off += n;
+        }
+    }
+    if (::close(fd) != 0) ok = false;
+    return ok;
+#else
+    std::fstream f(p, std::ios::binary | std::ios::in | std::ios::out);
+    if (!f) return false;
+    for (const auto& patch : patches) {
+        f.seekp(static_cast<std::streamoff>(patch.offset), std::ios::beg);
+        f.write(reinterpret_cast<const char*>(patch.bytes.data()), static_cast<std::streamsize>(patch.bytes.size()));
+    }
+    f.flush();
+    return f.good();
+#endif
+}
+
+} // namespace cdqt
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace cdqt {
+
+namespace fs = std::filesystem;
+
+// Read-only view of a whole file. Uses mmap where available, otherwise reads the file into memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const fs::path& p);
+    void close();
+
+    const std::uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool valid() const { return data_ != nullptr; }
+
+    // True when [off, off + len) lies inside the file.
+    bool inBounds(std::uint64_t off, std::uint64_t len) const {
+        return off <= size_ && len <= size_ - off;
+    }
+
+private:
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<std::uint8_t> fallback_;
+};
+
+// A byte range to overwrite in an existing file.
+struct FilePatch {
+    std::uint64_t offset;
+    std::vector<std::uint8_t> bytes;
+};
+
+// Writes each patch in place without truncating or rewriting the rest of the file.
+bool writeFilePatches(const fs::path& p, const std::vector<FilePatch>& patches);
+
+inline std::uint16_t readU16(const std::uint8_t* p, bool bigEndian) {
+    return bigEndian
+        ? static_cast<std::uint16_t>((p[0] << 8) | p[1])
+        : static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline std::uint32_t readU32(const std::uint8_t* p, bool bigEndian) {
+    return bigEndian
+        ? (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+          (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3])
+        : static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+          (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+inline std::uint64_t readU64(const std::uint8_t* p, bool bigEndian) {
+    const std::uint64_t a = readU32(p, bigEndian);
+    const std::uint64_t b = readU32(p + 4, bigEndian);
+    return bigEndian ? ((a << 32) | b) : ((b << 32) | a);
+}
+
+} // namespace cdqt
@@ -0,0 +1,221 @@
+#include "object_file.h"
+
+#include <algorithm>
+#include <fstream>
+#include <system_error>
+
+namespace cdqt {
+
+namespace {
+
+constexpr std::uint32_t MH_MAGIC     = 0xFEEDFACE;
+constexpr std::uint32_t MH_CIGAM     = 0xCEFAEDFE;
+constexpr std::uint32_t MH_MAGIC_64  = 0xFEEDFACF;
+constexpr std::uint32_t MH_CIGAM_64  = 0xCFFAEDFE;
+
+constexpr std::uint32_t FAT_MAGIC    = 0xCAFEBABE;
+constexpr std::uint32_t FAT_CIGAM    = 0xBEBAFECA;
+constexpr std::uint32_t FAT_MAGIC_64 = 0xCAFEBABF;
+constexpr std::uint32_t FAT_CIGAM_64 = 0xBFBAFECA;
+
+} // namespace
+
+bool TargetArch::accepts(const TargetArch& other) const {
+    if (type != other.type) return false;
+    if (type == BinaryType::ELF && (is64 != other.is64 || bigEndian != other.bigEndian)) return false;
+    for (std::uint32_t m : machines) {
+        if (std::find(other.machines.begin(), other.machines.end(), m) != other.machines.end()) return true;
+    }
+    return false;
+}
+
+std::optional<TargetArch> peekTargetArch(const fs::path& p) {
+    std::ifstream in(p, std::ios::binary);
+    if (!in) return std::nullopt;
+    std::uint8_t h[64] = {};
+    in.read(reinterpret_cast<char*>(h), sizeof(h));
+    const std::streamsize got = in.gcount();
+    if (got < 8) return std::nullopt;
+    in.clear();
+
+    TargetArch arch;
+    if (h[0] == 0x7F && h[1] == 'E' && h[2] == 'L' && h[3] == 'F') {
+        if (got < 20) return std::nullopt;
+        arch.type = BinaryType::ELF;
+        arch.is64 = h[4] == 2;
+        arch.bigEndian = h[5] == 2;
+        arch.machines.push_back(readU16(h + 18, arch.bigEndian));
+        return arch;
+    }
+
+    if (h[0] == 'M' && h[1] == 'Z' && got >= 0x40) {
+        std::uint8_t pe[6] = {};
+        in.seekg(readU32(h + 0x3C, false));
+        in.read(reinterpret_cast<char*>(pe), sizeof(pe));
+        if (in.gcount() == sizeof(pe) && pe[0] == 'P' && pe[1] == 'E' && pe[2] == 0 && pe[3] == 0) {
+            arch.type = BinaryType::PE;
+            arch.machines.push_back(readU16(pe + 4, false));
+            return arch;
+        }
+        return std::nullopt;
+    }
+
+    const std::uint32_t be = readU32(h, true);
+    if (be == MH_MAGIC || be == MH_CIGAM || be == MH_MAGIC_64 || be == MH_CIGAM_64) {
+        arch.type = BinaryType::MACHO;
+        arch.bigEndian = be == MH_MAGIC || be == MH_MAGIC_64;
+        arch.is64 = be == MH_MAGIC_64 || be == MH_CIGAM_64;
+        arch.machines.push_back(readU32(h + 4, arch.bigEndian));
+        return arch;
+    }
+    if (be == FAT_MAGIC || be == FAT_MAGIC_64 || be == FAT_CIGAM || be == FAT_CIGAM_64) {
+        const bool beHeader = (be == FAT_MAGIC || be == FAT_MAGIC_64);
+        const std::size_t entrySize = (be == FAT_MAGIC_64 || be == FAT_CIGAM_64) ? 32 : 20;
+        const std::uint32_t nfatArch = readU32(h + 4, beHeader);
+        if (nfatArch == 0 || nfatArch > 64) return std::nullopt;
+        std::vector<std::uint8_t> table(nfatArch * entrySize);
+        in.seekg(8);
+        in.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(table.size()));
+        if (in.gcount() != static_cast<std::streamsize>(table.size())) return std::nullopt;
+        arch.type = BinaryType::MACHO;
+        for (std::uint32_t i = 0; i < nfatArch; ++i) arch.machines.push_back(readU32(table.data() + i * entrySize, beHeader));
+        return arch;
+    }
+    return std::nullopt;
+}
+
+std::optional<ObjectFile> ObjectFile::open(const fs::path& p, std::string& whyNot) {
+    std::error_code ec;
+    const auto fileSize = fs::file_size(p, ec);
+    if (ec) { whyNot = "cannot stat file"; return std::nullopt; }
+    if (fileSize < 4) { whyNot = "file too small"; return std::nullopt; }
+
+    ObjectFile obj;
+    if (!obj.file_.open(p)) { whyNot = "cannot open file"; return std::nullopt; }
+    const std::uint8_t* d = obj.data();
+    const std::uint64_t size = obj.size();
+
+    // ELF: 0x7F 'E' 'L' 'F'
+    if (d[0] == 0x7F && d[1] == 'E' && d[2] == 'L' && d[3] == 'F') {
+        obj.type_ = BinaryType::ELF;
+        if (size >= 20) {
+            obj.is64_ = d[4] == 2;
+            obj.bigEndian_ = d[5] == 2;
+            obj.machine_ = obj.u16(18);
+        }
+        return obj;
+    }
+
+    // PE: 'MZ' then 'PE\0\0' at e_lfanew
+    if (d[0] == 'M' && d[1] == 'Z' && size >= 0x40) {
+        const std::uint32_t peOff = readU32(d + 0x3C, false);
+        if (obj.inBounds(peOff, 24) && d[peOff] == 'P' && d[peOff + 1] == 'E' && d[peOff + 2] == 0 && d[peOff + 3] == 0) {
+            obj.type_ = BinaryType::PE;
+            obj.machine_ = readU16(d + peOff + 4, false);
+            obj.peNumSections_ = readU16(d + peOff + 6, false);
+            obj.peOptSize_ = readU16(d + peOff + 20, false);
+            obj.peOptOffset_ = static_cast<std::uint64_t>(peOff) + 24;
+            if (obj.peOptSize_ >= 2 && obj.inBounds(obj.peOptOffset_, 2)) {
+                obj.is64_ = readU16(d + obj.peOptOffset_, false) == 0x20B;
+            }
+            return obj;
+        }
+        // Fall through; some non-PE files start with MZ.
+    }
+
+    // Mach-O: thin and fat (universal)
+    const std::uint32_t be = readU32(d, true);
+    if (be == MH_MAGIC || be == MH_CIGAM || be == MH_MAGIC_64 || be == MH_CIGAM_64) {
+        obj.type_ = BinaryType::MACHO;
+        obj.bigEndian_ = be == MH_MAGIC || be == MH_MAGIC_64;
+        obj.is64_ = be == MH_MAGIC_64 || be == MH_CIGAM_64;
+        if (size >= 8) obj.machine_ = obj.u32(4);
+        obj.slices_.push_back({obj.machine_, 0, size});
+        return obj;
+    }
+
+    if (be == FAT_MAGIC || be == FAT_MAGIC_64 || be == FAT_CIGAM || be == FAT_CIGAM_64) {
+        const bool beHeader = (be == FAT_MAGIC || be == FAT_MAGIC_64);
+        const bool fat64 = (be == FAT_MAGIC_64 || be == FAT_CIGAM_64);
+        if (size < 8) { whyNot = "truncated fat header"; return std::nullopt; }
+        const std::uint32_t nfatArch = readU32(d + 4, beHeader);
+
+        if (nfatArch == 0 || nfatArch > 64) {
+            whyNot = "CAFEBABE but invalid nfat_arch (likely not Mach-O)";
+            return std::nullopt;
+        }
+
+        const std::uint64_t entrySize = fat64 ? 32 : 20;
+        const std::uint64_t need = 8 + static_cast<std::uint64_t>(nfatArch) * entrySize;
+        if (need > size) { whyNot = "fat header larger than file"; return std::nullopt; }
+
+        obj.type_ = BinaryType::MACHO;
+        obj.fat_ = true;
+        obj.bigEndian_ = beHeader;
+        for (std::uint32_t i = 0; i < nfatArch; ++i) {
+            const std::uint8_t* a = d + 8 + i * entrySize;
+            MachOSlice s{};
+            s.cputype = readU32(a, beHeader);
+            s.offset = fat64 ? readU64(a + 8, beHeader) : readU32(a + 8, beHeader);
+            s.size = fat64 ? readU64(a + 16, beHeader) : readU32(a + 12, beHeader);
+            if (obj.inBounds(s.offset, s.size)) obj.slices_.push_back(s);
+        }
+        return obj;
+    }
+
+    whyNot = "unknown binary format";
+    return std::nullopt;
+}
+
+std::vector<ElfSegment> ObjectFile::elfSegments() const {
+    std::vector<ElfSegment> out;
+    if (type_ != BinaryType::ELF || !inBounds(0, is64_ ? 64 : 52)) return out;
+    const std::uint64_t phoff = is64_ ? u64(32) : u32(28);
+    const std::uint16_t phentsize = u16(is64_ ? 54 : 42);
+    const std::uint16_t phnum = u16(is64_ ? 56 : 44);
+    if (phentsize < (is64_ ? 56 : 32) || !inBounds(phoff, static_cast<std::uint64_t>(phentsize) * phnum)) return out;
+    out.reserve(phnum);
+    for (std::uint16_t i = 0; i < phnum; ++i) {
+        const std::uint64_t ph = phoff + static_cast<std::uint64_t>(i) * phentsize;
+        ElfSegment s{};
+        s.type = u32(ph);
+        if (is64_) {
+            s.flags = u32(ph + 4);
+            s.offset = u64(ph + 8);
+            s.vaddr = u64(ph + 16);
+            s.filesz = u64(ph + 32);
+            s.memsz = u64(ph + 40);
+        } else {
+            s.offset = u32(ph + 4);
+            s.vaddr = u32(ph + 8);
+            s.filesz = u32(ph + 16);
+            s.memsz = u32(ph + 20);
+            s.flags = u32(ph + 24);
+        }
+        out.push_back(s);
+    }
+    return out;
+}
+
+std::vector<PeSection> ObjectFile::peSections() const {
+    std::vector<PeSection> out;
+    if (type_ != BinaryType::PE) return out;
+    const std::uint64_t secOff = peOptOffset_ + peOptSize_;
+    if (!inBounds(secOff, static_cast<std::uint64_t>(peNumSections_) * 40)) return out;
+    out.reserve(peNumSections_);
+    for (std::uint16_t i = 0; i < peNumSections_; ++i) {
+        const std::uint8_t* s = data() + secOff + static_cast<std::uint64_t>(i) * 40;
+        PeSection sec;
+        size_t n = 0;
+        while (n < 8 && s[n] != 0) ++n;
+        sec.name.assign(reinterpret_cast<const char*>(s), n);
+        sec.vsize = readU32(s + 8, false);
+        sec.vaddr = readU32(s + 12, false);
+        sec.rawSize = readU32(s + 16, false);
+        sec.rawOffset = readU32(s + 20, false);
+        out.push_back(std::move(sec));
+    }
+    return out;
+}
+
+} // namespace cdqt
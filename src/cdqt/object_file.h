@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "mapped_file.h"
+
+namespace cdqt {
+
+struct ElfSegment {
+    std::uint32_t type;
+    std::uint32_t flags;
+    std::uint64_t offset;
+    std::uint64_t vaddr;
+    std::uint64_t filesz;
+    std::uint64_t memsz;
+};
+
+struct PeSection {
+    std::string name;
+    std::uint32_t vaddr;
+    std::uint32_t vsize;
+    std::uint32_t rawOffset;
+    std::uint32_t rawSize;
+};
+
+struct MachOSlice {
+    std::uint32_t cputype;
+    std::uint64_t offset; // of the thin image inside the file
+    std::uint64_t size;
+};
+
+// What a loader checks before it accepts a library: format, machine, word size and byte order. Mach-O
+// lists the cputype of every slice (cputype already encodes 64-bitness via CPU_ARCH_ABI64).
+struct TargetArch {
+    BinaryType type = BinaryType::ELF;
+    std::vector<std::uint32_t> machines;
+    bool is64 = false;
+    bool bigEndian = false;
+
+    // True if a library of architecture `other` can be loaded by a binary of this architecture; for fat
+    // Mach-O one common slice is enough.
+    bool accepts(const TargetArch& other) const;
+};
+
+// Reads just enough of the headers of `p` to tell its architecture (a few dozen bytes; the fat arch
+// table for universal binaries) without mapping the file. nullopt if it is not a recognised binary.
+std::optional<TargetArch> peekTargetArch(const fs::path& p);
+
+// One mmap of a binary plus everything detection learns from its headers. Detection, the dependency
+// readers and the SONAME lookup all work from this view so each file is opened and faulted in once.
+class ObjectFile {
+public:
+    static std::optional<ObjectFile> open(const fs::path& p, std::string& whyNot);
+    static std::optional<ObjectFile> open(const fs::path& p) { std::string ignored; return open(p, ignored); }
+
+    BinaryType type() const { return type_; }
+    bool is64() const { return is64_; }
+    bool bigEndian() const { return bigEndian_; }
+    // ELF e_machine, PE Machine, Mach-O cputype. 0 for fat Mach-O (see machoSlices()).
+    std::uint32_t machine() const { return machine_; }
+    bool isFat() const { return fat_; }
+
+    const std::uint8_t* data() const { return file_.data(); }
+    std::size_t size() const { return file_.size(); }
+    bool inBounds(std::uint64_t off, std::uint64_t len) const { return file_.inBounds(off, len); }
+    std::uint16_t u16(std::uint64_t off) const { return readU16(data() + off, bigEndian_); }
+    std::uint32_t u32(std::uint64_t off) const { return readU32(data() + off, bigEndian_); }
+    std::uint64_t u64(std::uint64_t off) const { return readU64(data() + off, bigEndian_); }
+
+    // ELF: program headers. Empty for other formats.
+    std::vector<ElfSegment> elfSegments() const;
+    // PE: offset/size of the optional header and the section table. Empty for other formats.
+    std::uint64_t peOptionalHeaderOffset() const { return peOptOffset_; }
+    std::uint16_t peOptionalHeaderSize() const { return peOptSize_; }
+    std::vector<PeSection> peSections() const;
+    // Mach-O: one entry per architecture; thin files have a single slice covering the file.
+    const std::vector<MachOSlice>& machoSlices() const { return slices_; }
+
+private:
+    MappedFile file_;
+    BinaryType type_ = BinaryType::ELF;
+    bool is64_ = false;
+    bool bigEndian_ = false;
+    bool fat_ = false;
+    std::uint32_t machine_ = 0;
+    std::uint64_t peOptOffset_ = 0;
+    std::uint16_t peOptSize_ = 0;
+    std::uint16_t peNumSections_ = 0;
+    std::vector<MachOSlice> slices_;
+};
+
+} // namespace cdqt
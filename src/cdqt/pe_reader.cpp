@@ -0,0 +1,93 @@
+#include "pe_reader.h"
+
+#include <cstdint>
+
+namespace cdqt {
+
+namespace {
+
+constexpr std::uint16_t PE32_MAGIC = 0x10B;
+constexpr std::uint16_t PE32PLUS_MAGIC = 0x20B;
+constexpr std::uint32_t DIR_IMPORT = 1;
+constexpr std::uint32_t DIR_DELAY_IMPORT = 13;
+
+} // namespace
+
+std::optional<PeImports> readPeImports(const ObjectFile& obj) {
+    if (obj.type() != BinaryType::PE) return std::nullopt;
+    const std::uint8_t* d = obj.data();
+    const std::uint64_t optOff = obj.peOptionalHeaderOffset();
+    const std::uint16_t optSize = obj.peOptionalHeaderSize();
+    if (optSize < 2 || !obj.inBounds(optOff, optSize)) return std::nullopt;
+
+    const std::uint8_t* opt = d + optOff;
+    const std::uint16_t magic = readU16(opt, false);
+    if (magic != PE32_MAGIC && magic != PE32PLUS_MAGIC) return std::nullopt;
+    const bool plus = magic == PE32PLUS_MAGIC;
+    const std::uint32_t numDirsOff = plus ? 108 : 92;
+    const std::uint32_t dirsOff = plus ? 112 : 96;
+    if (optSize < dirsOff) return std::nullopt;
+    const std::uint64_t imageBase = plus ? readU64(opt + 24, false) : readU32(opt + 28, false);
+    const std::uint32_t numDirs = readU32(opt + numDirsOff, false);
+    const std::vector<PeSection> sections = obj.peSections();
+
+    auto rvaToOffset = [&](std::uint64_t rva) -> std::optional<std::uint64_t> {
+        for (const auto& s : sections) {
+            const std::uint32_t span = s.vsize ? s.vsize : s.rawSize;
+            if (rva >= s.vaddr && rva - s.vaddr < span) {
+                const std::uint64_t delta = rva - s.vaddr;
+                if (delta >= s.rawSize) return std::nullopt; // lives in zero-fill, not in the file
+                return static_cast<std::uint64_t>(s.rawOffset) + delta;
+            }
+        }
+        return std::nullopt;
+    };
+
+    auto stringAtRva = [&](std::uint64_t rva) -> std::optional<std::string> {
+        auto off = rvaToOffset(rva);
+        if (!off || *off >= obj.size()) return std::nullopt;
+        const char* s = reinterpret_cast<const char*>(d + *off);
+        const std::uint64_t maxLen = obj.size() - *off;
+        std::uint64_t n = 0;
+        while (n < maxLen && s[n] != '\0') ++n;
+        if (n == maxLen || n == 0) return std::nullopt;
+        return std::string(s, static_cast<size_t>(n));
+    };
+
+    auto directoryRva = [&](std::uint32_t idx) -> std::uint32_t {
+        if (idx >= numDirs || dirsOff + (idx + 1) * 8 > optSize) return 0;
+        return readU32(opt + dirsOff + idx * 8, false);
+    };
+
+    PeImports out;
+
+    // IMAGE_IMPORT_DESCRIPTOR: 20 bytes, Name RVA at +12, terminated by an all-zero entry.
+    if (const std::uint32_t rva = directoryRva(DIR_IMPORT); rva != 0) {
+        auto off = rvaToOffset(rva);
+        if (!off) return std::nullopt;
+        for (std::uint64_t cur = *off; obj.inBounds(cur, 20); cur += 20) {
+            const std::uint32_t nameRva = readU32(d + cur + 12, false);
+            const std::uint32_t firstThunk = readU32(d + cur + 16, false);
+            if (nameRva == 0 && firstThunk == 0) break;
+            if (auto name = stringAtRva(nameRva)) out.imports.push_back(*name);
+        }
+    }
+
+    // IMAGE_DELAYLOAD_DESCRIPTOR: 32 bytes, DllNameRVA at +4. Pre-VC7 images (Attributes bit 0 clear)
+    // store virtual addresses instead of RVAs.
+    if (const std::uint32_t rva = directoryRva(DIR_DELAY_IMPORT); rva != 0) {
+        auto off = rvaToOffset(rva);
+        if (off) {
+            for (std::uint64_t cur = *off; obj.inBounds(cur, 32); cur += 32) {
+                const std::uint32_t attrs = readU32(d + cur, false);
+                std::uint64_t nameRef = readU32(d + cur + 4, false);
+                if (nameRef == 0) break;
+                if ((attrs & 1) == 0 && nameRef >= imageBase) nameRef -= imageBase;
+                if (auto name = stringAtRva(nameRef)) out.delayImports.push_back(*name);
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace cdqt
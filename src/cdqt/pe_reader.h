@@ -0,0 +1,21 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "object_file.h"
+
+namespace cdqt {
+
+struct PeImports {
+    std::vector<std::string> imports;      // import directory (DLL names, file order)
+    std::vector<std::string> delayImports; // delay-load import directory
+};
+
+// Reads the import and delay-load import directories of a PE32/PE32+ image, mapping RVAs through
+// the section table. Returns nullopt when the file is not a well-formed PE image.
+std::optional<PeImports> readPeImports(const ObjectFile& obj);
+
+} // namespace cdqt
@@ -0,0 +1,141 @@
+#include "persistent_cache.h"
+
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "util.h"
+
+namespace cdqt {
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'D', 'Q', 'T', 'P', 'C', '1', '\0'};
+
+// Entry, after its key: identity, type, cpuType, then the ParseResult fields.
+void writeEntry(ByteWriter& w, std::string_view key, const FileIdentity& id, std::uint8_t type, std::uint32_t cpuType,
+                const ParseResult& pr) {
+    w.str(key);
+    w.identity(id);
+    w.u8(type);
+    w.u32(cpuType);
+    writeParseResult(w, pr);
+}
+
+} // namespace
+
+std::uint8_t typeTag(BinaryType t) {
+    switch (t) {
+        case BinaryType::PE: return 1;
+        case BinaryType::ELF: return 2;
+        case BinaryType::MACHO: return 3;
+    }
+    return 0;
+}
+
+ParseResult readParseResult(ByteReader& r) {
+    ParseResult pr;
+    pr.dependencies = r.strings();
+    pr.rpaths = r.strings();
+    pr.installName = r.optString();
+    pr.soname = r.optString();
+    return pr;
+}
+
+void writeParseResult(ByteWriter& w, const ParseResult& pr) {
+    w.strings(pr.dependencies);
+    w.strings(pr.rpaths);
+    w.optString(pr.installName);
+    w.optString(pr.soname);
+}
+
+PersistentParseCache::PersistentParseCache(fs::path cacheDir) : file_(std::move(cacheDir) / "parse-cache.bin") {
+    std::error_code ec;
+    if (!fs::exists(file_, ec) || !mapped_.open(file_)) return;
+    ByteReader r{mapped_.data(), mapped_.size()};
+    if (!r.need(sizeof(kMagic)) || std::memcmp(r.data, kMagic, sizeof(kMagic)) != 0) return;
+    r.pos += sizeof(kMagic);
+    const std::uint32_t count = r.u32();
+    for (std::uint32_t i = 0; i < count && r.ok; ++i) {
+        const std::string_view key = r.str();
+        const std::size_t entry = r.pos;
+        r.identity();
+        r.u8();
+        r.u32();
+        readParseResult(r);
+        if (r.ok) index_[key] = entry;
+    }
+    if (!r.ok) {
+        // Truncated or corrupt: start over rather than trust any of it.
+        index_.clear();
+        mapped_.close();
+    }
+    if (isVerbose()) std::cout << "[cache] " << index_.size() << " parse entries from " << file_ << "\n";
+}
+
+std::optional<ParseResult> PersistentParseCache::lookup(const std::string& key, BinaryType type, std::uint32_t cpuType) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!fresh_.count(key) && !index_.count(key)) return std::nullopt;
+    }
+    // Stat without the lock; other threads keep looking up meanwhile.
+    const auto id = cacheIdentity(key);
+    if (!id) return std::nullopt;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto fit = fresh_.find(key);
+    auto it = index_.find(key);
+    if (fit != fresh_.end()) {
+        const Fresh& f = fit->second;
+        if (f.id != *id || f.type != typeTag(type) || f.cpuType != cpuType) return std::nullopt;
+        ++hits_;
+        return f.result;
+    }
+    ByteReader r{mapped_.data(), mapped_.size(), it->second};
+    if (r.identity() != *id || r.u8() != typeTag(type) || r.u32() != cpuType) return std::nullopt;
+    ParseResult pr = readParseResult(r);
+    if (!r.ok) return std::nullopt;
+    ++hits_;
+    return pr;
+}
+
+void PersistentParseCache::store(const std::string& key, BinaryType type, std::uint32_t cpuType, const ParseResult& result) {
+    const auto id = cacheIdentity(key);
+    if (!id) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    fresh_[key] = Fresh{*id, typeTag(type), cpuType, result};
+}
+
+bool PersistentParseCache::save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fresh_.empty()) return true;
+    ByteWriter w;
+    w.buf.append(kMagic, sizeof(kMagic));
+    w.u32(0); // count, patched below
+    std::uint32_t count = 0;
+    for (const auto& [key, entry] : index_) {
+        if (fresh_.count(std::string(key))) continue;
+        ByteReader r{mapped_.data(), mapped_.size(), entry};
+        const FileIdentity id = r.identity();
+        const auto current = cacheIdentity(fs::path(key));
+        if (!current || *current != id) continue; // file changed or gone; drop the entry
+        const std::uint8_t type = r.u8();
+        const std::uint32_t cpuType = r.u32();
+        writeEntry(w, key, id, type, cpuType, readParseResult(r));
+        ++count;
+    }
+    for (const auto& [key, f] : fresh_) {
+        writeEntry(w, key, f.id, f.type, f.cpuType, f.result);
+        ++count;
+    }
+    w.patchU32(sizeof(kMagic), count);
+
+    // Drop the mapping first: the file is about to be replaced.
+    mapped_.close();
+    index_.clear();
+    if (!writeFileAtomic(file_, w.buf)) return false;
+    if (isVerbose()) std::cout << "[cache] wrote " << count << " parse entries to " << file_ << "\n";
+    return true;
+}
+
+} // namespace cdqt
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "cache_io.h"
+#include "common.h"
+#include "deps_parse.h"
+#include "mapped_file.h"
+
+namespace cdqt {
+
+// On-disk encoding shared by the caches that store parse results.
+std::uint8_t typeTag(BinaryType t);
+ParseResult readParseResult(ByteReader& r);
+void writeParseResult(ByteWriter& w, const ParseResult& pr);
+
+// ParseResults kept across runs in <cacheDir>/parse-cache.bin. The file is mmapped on open and entries
+// are decoded on lookup; an entry is used only while the file's identity still matches (for Nix store
+// paths the path itself is the identity). New results are written back by save() through a temporary
+// file and a rename, so concurrent runs never see a partial cache.
+class PersistentParseCache {
+public:
+    explicit PersistentParseCache(fs::path cacheDir);
+
+    std::optional<ParseResult> lookup(const std::string& key, BinaryType type, std::uint32_t cpuType) const;
+    void store(const std::string& key, BinaryType type, std::uint32_t cpuType, const ParseResult& result);
+
+    // Writes loaded entries that are still current plus everything stored this run.
+    bool save();
+
+    std::size_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+
+private:
+    struct Fresh {
+        FileIdentity id;
+        std::uint8_t type;
+        std::uint32_t cpuType;
+        ParseResult result;
+    };
+
+    fs::path file_;
+    MappedFile mapped_;
+    std::unordered_map<std::string_view, std::size_t> index_; // key -> entry offset in mapped_
+    std::unordered_map<std::string, Fresh> fresh_;
+    mutable std::size_t hits_ = 0;
+    mutable std::mutex mutex_; // lookup and store may be called from several threads
+};
+
+} // namespace cdqt
@@ -1,12 +1,18 @@
 #include "qml.h"
 
 #include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <string_view>
 #include <unordered_set>
+#include <utility>
 
+#include "cache_io.h"
 #include "deps_parse.h"
 #include "fs_ops.h"
+#include "qt_index.h"
 #include "qt_paths.h"
 #include "resolve.h"
 #include "stage.h"
@@ -48,63 +54,151 @@ static std::vector<fs::path> discoverQmlRoots(const ResolveContext& ctx) {
     return roots;
 }
 
+// Scanner results are cached per root in <cacheDir>/qml-scan/<fingerprint>. The fingerprint covers the
+// root, the path, size and mtime of every .qml/.js/.mjs/qmldir file below it, the import paths and the
+// scanner binary, so any change that could alter the scan selects a different cache file.
+static std::optional<std::uint64_t> scanFingerprint(const ResolveContext& ctx, const fs::path& root,
+                                                    const std::vector<std::string>& importArgs) {
+    auto scanner = findProgram("qmlimportscanner");
+    if (!scanner) return std::nullopt;
+    const auto scannerId = fileIdentity(*scanner);
+    if (!scannerId) return std::nullopt;
+
+    std::vector<std::pair<std::string, FileIdentity>> sources;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        const fs::path& p = it->path();
+        const fs::path ext = p.extension();
+        if (ext != ".qml" && ext != ".js" && ext != ".mjs" && p.filename() != "qmldir") continue;
+        if (!it->is_regular_file(ec)) continue;
+        auto id = fileIdentity(p);
+        if (!id) return std::nullopt;
+        sources.emplace_back(p.string(), *id);
+    }
+    if (ec) return std::nullopt;
+    // Directory iteration order is unspecified; hash in path order.
+    std::sort(sources.begin(), sources.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+
+    auto mix = [](std::uint64_t h, std::uint64_t v) { return fnv1a(v, h); };
+    std::uint64_t h = fnv1a(root.string());
+    h = fnv1a(std::string_view("\0", 1), h);
+    h = fnv1a(scanner->string(), h);
+    h = mix(mix(mix(h, scannerId->ino), scannerId->size), static_cast<std::uint64_t>(scannerId->mtimeNs));
+    h = fnv1a(ctx.qt.qtInstallQml.string(), h);
+    for (const auto& a : importArgs) h = fnv1a(std::string_view("\0", 1), fnv1a(a, h));
+    for (const auto& [path, id] : sources) {
+        h = fnv1a(std::string_view("\0", 1), fnv1a(path, h));
+        h = mix(mix(h, id.size), static_cast<std::uint64_t>(id.mtimeNs));
+    }
+    return h;
+}
+
+static fs::path scanCacheFile(const fs::path& cacheDir, std::uint64_t fingerprint) {
+    return cacheDir / "qml-scan" / hex64(fingerprint);
+}
+
+constexpr std::string_view kScanCacheHeader = "crossdeployqt qml-scan 1";
+
+// One module per line: sourcePath, a tab, relativePath. Rejected if any module directory is gone.
+static std::optional<std::vector<QmlModuleEntry>> loadScanCache(const fs::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) return std::nullopt;
+    std::string line;
+    if (!std::getline(in, line) || line != kScanCacheHeader) return std::nullopt;
+    std::vector<QmlModuleEntry> modules;
+    while (std::getline(in, line)) {
+        auto tab = line.find('\t');
+        if (tab == std::string::npos) return std::nullopt;
+        QmlModuleEntry m{fs::path(line.substr(0, tab)), line.substr(tab + 1)};
+        std::error_code ec;
+        if (!fs::exists(m.sourcePath, ec)) return std::nullopt;
+        modules.push_back(std::move(m));
+    }
+    return modules;
+}
+
+static void saveScanCache(const fs::path& file, const std::vector<QmlModuleEntry>& modules) {
+    std::ostringstream buf;
+    buf << kScanCacheHeader << "\n";
+    for (const auto& m : modules) {
+        const std::string sp = m.sourcePath.string();
+        if (sp.find_first_of("\t\n") != std::string::npos || m.relativePath.find_first_of("\t\n") != std::string::npos) return;
+        buf << sp << "\t" << m.relativePath << "\n";
+    }
+    writeFileAtomic(file, buf.str());
+}
+
+// Runs qmlimportscanner on one root. Returns nullopt if the scanner failed.
+static std::optional<std::vector<QmlModuleEntry>> scanRoot(const ResolveContext& ctx, const fs::path& root,
+                                                           const std::vector<std::string>& importArgs) {
+    std::vector<std::string> argv{"qmlimportscanner", "-rootPath", root.string()};
+    argv.insert(argv.end(), importArgs.begin(), importArgs.end());
+    std::vector<QmlModuleEntry> found;
+    QmlModuleEntry current;
+    bool inObject = false;
+    // The scanner prints one key per line; the string value of `key` on this line, if any.
+    auto stringValue = [](std::string_view line, std::string_view key) -> std::optional<std::string_view> {
+        auto kpos = line.find(key);
+        if (kpos == std::string_view::npos) return std::nullopt;
+        auto q1 = line.find('"', kpos + key.size());
+        auto q2 = q1 == std::string_view::npos ? std::string_view::npos : line.find('"', q1 + 1);
+        if (q2 == std::string_view::npos) return std::nullopt;
+        return line.substr(q1 + 1, q2 - q1 - 1);
+    };
+    const int code = runProcess(argv, [&](std::string_view line) {
+        if (line.find('{') != std::string_view::npos) { inObject = true; current = QmlModuleEntry(); }
+        if (inObject) {
+            if (auto v = stringValue(line, "\"path\"")) current.sourcePath = fs::path(*v);
+            if (auto v = stringValue(line, "\"relativePath\"")) current.relativePath = std::string(*v);
+        }
+        if (line.find('}') != std::string_view::npos && inObject) {
+            inObject = false;
+            if (!current.sourcePath.empty()) {
+                if (current.relativePath.empty()) {
+                    std::string sp = current.sourcePath.string();
+                    std::string qp = ctx.qt.qtInstallQml.string();
+                    if (!qp.empty() && sp.rfind(qp, 0) == 0) {
+                        std::string rel = sp.substr(qp.size());
+                        if (!rel.empty() && (rel[0] == '/' || rel[0] == '\\')) rel.erase(0, 1);
+                        current.relativePath = rel;
+                    } else {
+                        current.relativePath = current.sourcePath.filename().string();
+                    }
+                }
+                found.push_back(current);
+            }
+        }
+    }).exitCode;
+    if (code != 0) return std::nullopt;
+    return found;
+}
+
 static std::vector<QmlModuleEntry> runQmlImportScanner(const ResolveContext& ctx, const std::vector<fs::path>& roots) {
     std::vector<QmlModuleEntry> result;
     if (roots.empty()) return result;
 
-    std::string importArgs;
+    std::vector<std::string> importArgs;
     for (const auto& p : ctx.qmlImportPaths) {
-        importArgs += " -importPath " + shellEscape(p.string());
+        importArgs.push_back("-importPath");
+        importArgs.push_back(p.string());
     }
 
+    const fs::path& cacheDir = ctx.plan.cacheDir;
     for (const auto& root : roots) {
-        int code = 0;
-        std::string cmd = std::string("qmlimportscanner -rootPath ") + shellEscape(root.string()) + importArgs;
-        std::string out = runCommand(cmd, code);
-        if (code != 0 || out.empty()) continue;
-
-        std::istringstream iss(out);
-        std::string line;
-        QmlModuleEntry current;
-        bool inObject = false;
-        while (std::getline(iss, line)) {
-            if (line.find('{') != std::string::npos) { inObject = true; current = QmlModuleEntry(); }
-            if (inObject) {
-                auto ppos = line.find("\"path\"");
-                if (ppos != std::string::npos) {
-                    auto q1 = line.find('"', ppos + 6);
-                    auto q2 = q1 == std::string::npos ? std::string::npos : line.find('"', q1 + 1);
-                    if (q1 != std::string::npos && q2 != std::string::npos) {
-                        current.sourcePath = fs::path(line.substr(q1 + 1, q2 - q1 - 1));
-                    }
-                }
-                auto rpos = line.find("\"relativePath\"");
-                if (rpos != std::string::npos) {
-                    auto q1 = line.find('"', rpos + 14);
-                    auto q2 = q1 == std::string::npos ? std::string::npos : line.find('"', q1 + 1);
-                    if (q1 != std::string::npos && q2 != std::string::npos) {
-                        current.relativePath = line.substr(q1 + 1, q2 - q1 - 1);
-                    }
-                }
-            }
-            if (line.find('}') != std::string::npos && inObject) {
-                inObject = false;
-                if (!current.sourcePath.empty()) {
-                    if (current.relativePath.empty()) {
-                        std::string sp = current.sourcePath.string();
-                        std::string qp = ctx.qt.qtInstallQml.string();
-                        if (!qp.empty() && sp.rfind(qp, 0) == 0) {
-                            std::string rel = sp.substr(qp.size());
-                            if (!rel.empty() && (rel[0] == '/' || rel[0] == '\\')) rel.erase(0, 1);
-                            current.relativePath = rel;
-                        } else {
-                            current.relativePath = current.sourcePath.filename().string();
-                        }
-                    }
-                    result.push_back(current);
-                }
+        std::optional<std::uint64_t> fingerprint;
+        if (!cacheDir.empty()) fingerprint = scanFingerprint(ctx, root, importArgs);
+        if (fingerprint) {
+            if (auto cached = loadScanCache(scanCacheFile(cacheDir, *fingerprint))) {
+                if (isVerbose()) std::cout << "[qml] scan cache hit: " << root << "\n";
+                result.insert(result.end(), cached->begin(), cached->end());
+                continue;
             }
         }
+        auto found = scanRoot(ctx, root, importArgs);
+        if (!found) continue;
+        if (fingerprint) saveScanCache(scanCacheFile(cacheDir, *fingerprint), *found);
+        result.insert(result.end(), found->begin(), found->end());
     }
 
     std::sort(result.begin(), result.end(), [](const QmlModuleEntry& a, const QmlModuleEntry& b){ return a.sourcePath < b.sourcePath; });
@@ -134,56 +228,62 @@ void copyQmlModules(const ResolveContext& ctx, const DeployPlan& plan) {
         fs::path dst = qmlDestBase / m.relativePath;
         fs::create_directories(dst, ec);
         ec.clear();
+        // Stages one file of the module; `linkTarget` is the resolved target when `src` is a symlink.
+        auto stageFile = [&](const fs::path& src, const fs::path& rel, bool isLink, const fs::path& linkTarget) {
+            fs::path out = dst / rel;
+
+            if (plan.type == BinaryType::MACHO) {
+                const fs::path target = isLink && !linkTarget.empty() ? linkTarget : src;
+                if (target.extension() == ".dylib") {
+                    fs::path quickDir = plan.outputRoot / "Contents" / "PlugIns" / "quick";
+                    fs::create_directories(quickDir, ec);
+                    fs::path moved = quickDir / target.filename();
+                    if (isVerbose()) std::cout << "[qml] stage dylib: " << target << " -> " << moved << "\n";
+                    if (!copyFileOverwrite(target, moved)) {
+                        throw std::runtime_error(std::string("Failed to copy QML plugin dylib: ") + target.string());
+                    }
+                    std::error_code mkEc;
+                    fs::create_directories(out.parent_path(), mkEc);
+                    std::error_code rmEc;
+                    fs::remove(out, rmEc);
+                    try {
+                        fs::create_symlink(fs::relative(moved, out.parent_path()), out);
+                    } catch (...) {
+                        copyFileOverwrite(moved, out);
+                    }
+                    return;
+                }
+            }
+            if (isLink) return;
+
+            if (!copyFileOverwrite(src, out)) {
+                throw std::runtime_error(std::string("Failed to copy QML file: ") + src.string());
+            }
+        };
         try {
+            if (auto files = ctx.qtIndex ? ctx.qtIndex->qmlModuleFiles(m.sourcePath) : std::nullopt) {
+                for (const auto& f : *files) stageFile(m.sourcePath / f.relativePath, f.relativePath, f.isSymlink, f.linkTarget);
+                continue;
+            }
             for (auto it = fs::recursive_directory_iterator(m.sourcePath, fs::directory_options::skip_permission_denied, ec);
                  it != fs::recursive_directory_iterator(); ++it) {
                 if (it->is_directory(ec)) continue;
 
                 fs::path src = it->path();
                 fs::path rel = fs::relative(src, m.sourcePath, ec);
-                fs::path out = dst / rel;
-
-                if (plan.type == BinaryType::MACHO) {
-                    std::error_code isSymlinkEc;
-                    const bool isLink = it->is_symlink(isSymlinkEc);
-                    fs::path target = src;
-                    if (isLink) {
-                        std::error_code le;
-                        fs::path linkTarget = fs::read_symlink(src, le);
-                        if (!le) {
-                            std::error_code wc;
-                            fs::path absTarget = fs::weakly_canonical(src.parent_path() / linkTarget, wc);
-                            if (!wc) target = absTarget;
-                        }
-                    }
-                    if (target.extension() == ".dylib") {
-                        fs::path quickDir = plan.outputRoot / "Contents" / "PlugIns" / "quick";
-                        fs::create_directories(quickDir, ec);
-                        fs::path moved = quickDir / target.filename();
-                        if (isVerbose()) std::cout << "[qml] stage dylib: " << target << " -> " << moved << "\n";
-                        if (!copyFileOverwrite(target, moved)) {
-                            throw std::runtime_error(std::string("Failed to copy QML plugin dylib: ") + target.string());
-                        }
-                        std::error_code mkEc;
-                        fs::create_directories(out.parent_path(), mkEc);
-                        std::error_code rmEc;
-                        fs::remove(out, rmEc);
-                        try {
-                            fs::create_symlink(fs::relative(moved, out.parent_path()), out);
-                        } catch (...) {
-                            copyFileOverwrite(moved, out);
-                        }
-                        continue;
+                std::error_code isSymlinkEc;
+                const bool isLink = it->is_symlink(isSymlinkEc);
+                fs::path linkTarget;
+                if (isLink && plan.type == BinaryType::MACHO) {
+                    std::error_code le;
+                    fs::path link = fs::read_symlink(src, le);
+                    if (!le) {
+                        std::error_code wc;
+                        fs::path absTarget = fs::weakly_canonical(src.parent_path() / link, wc);
+                        if (!wc) linkTarget = absTarget;
                     }
-                    if (isLink) continue;
-                } else {
-                    std::error_code isLinkEc2;
-                    if (it->is_symlink(isLinkEc2)) continue;
-                }
-
-                if (!copyFileOverwrite(src, out)) {
-                    throw std::runtime_error(std::string("Failed to copy QML file: ") + src.string());
                 }
+                stageFile(src, rel, isLink, linkTarget);
             }
         } catch (...) {
             std::cerr << "Warning: failed to traverse QML module: " << m.sourcePath << "\n";
@@ -223,49 +323,15 @@ static std::vector<fs::path> listQmlPluginLibraries(const DeployPlan& plan) {
     return libs;
 }
 
-void resolveQmlPluginDependencies(const DeployPlan& plan) {
+void resolveQmlPluginDependencies(DeploySession& session) {
+    const DeployPlan& plan = session.ctx.plan;
     auto qmlLibs = listQmlPluginLibraries(plan);
     if (qmlLibs.empty()) return;
 
-    ResolveContext ctx{plan, queryQtPaths(), {}, {}, {}, {}};
-    ensureEnvForResolution(ctx);
-
-    std::vector<fs::path> stack;
-    for (const auto& lib : qmlLibs) {
-        if (isVerbose()) std::cout << "[qml-deps] seed: " << lib << "\n";
-        stack.push_back(lib);
-    }
-
-    std::unordered_set<std::string> visited;
-    std::unordered_set<std::string> result;
-    ParseCache cache;
-
-    while (!stack.empty()) {
-        fs::path cur = stack.back();
-        stack.pop_back();
-        std::error_code ec;
-        fs::path canon = fs::weakly_canonical(cur, ec);
-        std::string key = ec ? cur.string() : canon.string();
-        if (visited.count(key)) continue;
-        visited.insert(key);
-
-        const ParseResult& prChild = parseDepsCached(cur, plan.type, cache);
-        for (const auto& dep : prChild.dependencies) {
-            if (isVerbose()) std::cout << "[qml-deps]   dep: " << dep << "\n";
-            std::optional<fs::path> found = resolveRef(plan.type, dep, cur, prChild, ctx, cache, plan.binaryPath);
-            if (found) {
-                if (shouldDeployLibrary(*found, dep, plan.type, ctx)) {
-                    std::string fkey = fs::weakly_canonical(*found, ec).string();
-                    if (isVerbose()) std::cout << "[qml-deps]     push: " << *found << "\n";
-                    if (!visited.count(fkey)) stack.push_back(*found);
-                    result.insert(fkey);
-                }
-            }
-        }
+    if (isVerbose()) {
+        for (const auto& lib : qmlLibs) std::cout << "[qml-deps] seed: " << lib << "\n";
     }
-
-    std::vector<fs::path> uniqueDeps;
-    for (const auto& k : result) uniqueDeps.emplace_back(k);
+    const std::vector<fs::path> uniqueDeps = dependencyClosure(qmlLibs, session, false, "qml-deps");
     if (uniqueDeps.empty()) return;
 
     if (plan.type == BinaryType::PE) copyResolvedForPE(plan, uniqueDeps);
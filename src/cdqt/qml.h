@@ -6,7 +6,8 @@
 namespace cdqt {
 
 void copyQmlModules(const ResolveContext& ctx, const DeployPlan& plan);
-void resolveQmlPluginDependencies(const DeployPlan& plan);
+// Deploys the dependencies of the staged QML plugins that no earlier phase resolved.
+void resolveQmlPluginDependencies(DeploySession& session);
 
 } // namespace cdqt
 
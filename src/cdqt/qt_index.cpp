@@ -0,0 +1,401 @@
+#include "qt_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+
+#include "cache_io.h"
+#include "persistent_cache.h"
+#include "util.h"
+
+namespace cdqt {
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'D', 'Q', 'T', 'Q', 'I', '2', '\0'};
+
+fs::path indexFile(const fs::path& cacheDir, const QtPathsInfo& qt) {
+    const fs::path& id = qt.qtInstallPrefix.empty() ? qt.qtInstallLibs : qt.qtInstallPrefix;
+    return cacheDir / "qt-index" / (hex64(fnv1a(id.string())) + ".bin");
+}
+
+std::vector<const fs::path*> qtPathFields(const QtPathsInfo& qt) {
+    return {&qt.qtInstallPrefix, &qt.qtInstallLibs, &qt.qtInstallBins,
+            &qt.qtInstallPlugins, &qt.qtInstallQml, &qt.qtInstallTranslations};
+}
+
+std::optional<BinaryType> typeFromTag(std::uint8_t tag) {
+    for (BinaryType t : {BinaryType::PE, BinaryType::ELF, BinaryType::MACHO}) {
+        if (typeTag(t) == tag) return t;
+    }
+    return std::nullopt;
+}
+
+// Library record, after its key and file identity: type, is64, bigEndian, machines, then one ParseResult
+// per fat slice read (a single one, for slice 0, when the file is thin).
+TargetArch readArch(ByteReader& r) {
+    TargetArch arch;
+    arch.type = typeFromTag(r.u8()).value_or(BinaryType::ELF);
+    arch.is64 = r.u8() != 0;
+    arch.bigEndian = r.u8() != 0;
+    const std::uint32_t n = r.u32();
+    for (std::uint32_t i = 0; i < n && r.ok; ++i) arch.machines.push_back(r.u32());
+    return arch;
+}
+
+struct WalkEntry {
+    fs::path path;
+    bool isSymlink = false;
+};
+
+// Lists `dir` into `entries` (everything but real directories), descending into the subdirectories
+// `descend` accepts. Every listed directory's identity goes to `stamps` so a later change is noticed.
+void walk(const fs::path& dir, const std::function<bool(const fs::path&)>& descend, std::vector<WalkEntry>& entries,
+          std::vector<std::pair<std::string, FileIdentity>>& stamps) {
+    auto id = cacheIdentity(dir);
+    if (!id) return;
+    stamps.emplace_back(dir.string(), *id);
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+         !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        std::error_code te;
+        const bool link = it->is_symlink(te);
+        if (!link && it->is_directory(te)) {
+            if (descend(it->path())) walk(it->path(), descend, entries, stamps);
+            continue;
+        }
+        entries.push_back({it->path(), link});
+    }
+}
+
+struct LibRecord {
+    std::string key;
+    FileIdentity id;
+    TargetArch arch;
+    std::vector<std::pair<std::uint32_t, ParseResult>> parses;
+};
+
+std::optional<LibRecord> indexBinary(const fs::path& p) {
+    auto arch = peekTargetArch(p);
+    if (!arch) return std::nullopt;
+    const fs::path key = canonicalPath(p);
+    auto id = cacheIdentity(key);
+    if (!id) return std::nullopt;
+    LibRecord rec{key.string(), *id, *arch, {}};
+    if (arch->type == BinaryType::ELF) {
+        rec.parses.emplace_back(0, parseELF(p));
+    } else if (arch->type == BinaryType::PE) {
+        rec.parses.emplace_back(0, parsePE(p));
+    } else {
+        rec.parses.emplace_back(0, parseMachO(p, 0));
+        if (arch->machines.size() > 1) {
+            for (std::uint32_t cpu : arch->machines) rec.parses.emplace_back(cpu, parseMachO(p, cpu));
+        }
+    }
+    return rec;
+}
+
+} // namespace
+
+std::optional<QtIndexSummary> buildQtIndex(const fs::path& cacheDir, const QtPathsInfo& qt, unsigned jobs) {
+    std::vector<std::pair<std::string, FileIdentity>> stamps;
+    auto always = [](const fs::path&) { return true; };
+    auto never = [](const fs::path&) { return false; };
+    // The library directory is often shared with the rest of the system (/usr/lib/<triple>), so only
+    // its files and frameworks are listed, not whatever other trees live below it.
+    auto frameworks = [](const fs::path& d) { return d.string().find(".framework") != std::string::npos; };
+
+    std::vector<WalkEntry> binEntries, pluginEntries, qmlEntries, trEntries;
+    std::unordered_set<std::string> walked;
+    auto walkOnce = [&](const fs::path& root, const std::function<bool(const fs::path&)>& descend, std::vector<WalkEntry>& out) {
+        std::error_code ec;
+        if (root.empty() || !fs::is_directory(root, ec)) return;
+        if (!walked.insert(canonicalPath(root).string()).second) return;
+        walk(root, descend, out, stamps);
+    };
+    walkOnce(qt.qtInstallLibs, frameworks, binEntries);
+    walkOnce(qt.qtInstallBins, never, binEntries);
+    walkOnce(qt.qtInstallPlugins, always, pluginEntries);
+    walkOnce(qt.qtInstallQml, always, qmlEntries);
+    walkOnce(qt.qtInstallTranslations, never, trEntries);
+
+    // Every regular file that is a binary, parsed on the pool.
+    std::vector<fs::path> candidates;
+    std::vector<WalkEntry> links;
+    for (const auto* list : {&binEntries, &pluginEntries, &qmlEntries}) {
+        for (const auto& e : *list) {
+            if (e.isSymlink) links.push_back(e);
+            else candidates.push_back(e.path);
+        }
+    }
+    std::vector<LibRecord> libs;
+    {
+        JobPool pool(jobs);
+        std::vector<std::future<std::optional<LibRecord>>> parsed;
+        parsed.reserve(candidates.size());
+        for (const auto& p : candidates) parsed.push_back(pool.submit([p] { return indexBinary(p); }));
+        for (auto& f : parsed) {
+            if (auto rec = f.get()) libs.push_back(std::move(*rec));
+        }
+    }
+    std::sort(libs.begin(), libs.end(), [](const LibRecord& a, const LibRecord& b) { return a.key < b.key; });
+    libs.erase(std::unique(libs.begin(), libs.end(), [](const LibRecord& a, const LibRecord& b) { return a.key == b.key; }),
+               libs.end());
+    std::unordered_set<std::string_view> libKeys;
+    for (const auto& l : libs) libKeys.insert(l.key);
+
+    std::vector<std::pair<std::string, std::string>> aliases;
+    for (const auto& p : candidates) {
+        std::string key = canonicalPath(p).string();
+        if (key != p.string() && libKeys.count(key)) aliases.emplace_back(p.string(), std::move(key));
+    }
+    for (const auto& e : links) {
+        std::string key = canonicalPath(e.path).string();
+        if (libKeys.count(key)) aliases.emplace_back(e.path.string(), std::move(key));
+    }
+
+    std::vector<std::string> plugins;
+    for (const auto& e : pluginEntries) {
+        const fs::path category = e.path.parent_path();
+        if (category.parent_path() == qt.qtInstallPlugins) plugins.push_back((category.filename() / e.path.filename()).generic_string());
+    }
+
+    // A QML module is a directory with a qmldir; its files are everything below it, as copyQmlModules
+    // would find them walking the directory.
+    std::sort(qmlEntries.begin(), qmlEntries.end(), [](const WalkEntry& a, const WalkEntry& b) { return a.path < b.path; });
+    std::vector<fs::path> modules;
+    for (const auto& e : qmlEntries) {
+        if (e.path.filename() == "qmldir") modules.push_back(e.path.parent_path());
+    }
+
+    std::vector<std::pair<std::string, FileIdentity>> catalogs;
+    for (const auto& e : trEntries) {
+        if (e.path.extension() != ".qm") continue;
+        if (auto id = cacheIdentity(e.path)) catalogs.emplace_back(e.path.filename().string(), *id);
+    }
+    std::sort(catalogs.begin(), catalogs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    ByteWriter w;
+    w.buf.append(kMagic, sizeof(kMagic));
+    for (const fs::path* f : qtPathFields(qt)) w.str(f->string());
+    w.u32(static_cast<std::uint32_t>(stamps.size()));
+    for (const auto& [dir, id] : stamps) {
+        w.str(dir);
+        w.identity(id);
+    }
+    w.u32(static_cast<std::uint32_t>(libs.size()));
+    for (const auto& l : libs) {
+        w.str(l.key);
+        w.identity(l.id);
+        w.u8(typeTag(l.arch.type));
+        w.u8(l.arch.is64 ? 1 : 0);
+        w.u8(l.arch.bigEndian ? 1 : 0);
+        w.u32(static_cast<std::uint32_t>(l.arch.machines.size()));
+        for (std::uint32_t m : l.arch.machines) w.u32(m);
+        w.u32(static_cast<std::uint32_t>(l.parses.size()));
+        for (const auto& [cpu, pr] : l.parses) {
+            w.u32(cpu);
+            writeParseResult(w, pr);
+        }
+    }
+    w.u32(static_cast<std::uint32_t>(aliases.size()));
+    for (const auto& [alias, key] : aliases) {
+        w.str(alias);
+        w.str(key);
+    }
+    w.strings(plugins);
+    w.u32(static_cast<std::uint32_t>(modules.size()));
+    for (const auto& dir : modules) {
+        w.str(dir.string());
+        const std::size_t countAt = w.buf.size();
+        w.u32(0);
+        std::uint32_t count = 0;
+        const std::string prefix = dir.string() + '/';
+        auto it = std::lower_bound(qmlEntries.begin(), qmlEntries.end(), fs::path(prefix),
+                                   [](const WalkEntry& e, const fs::path& p) { return e.path < p; });
+        for (; it != qmlEntries.end() && it->path.string().rfind(prefix, 0) == 0; ++it) {
+            fs::path target;
+            if (it->isSymlink) {
+                std::error_code ec;
+                if (fs::is_directory(it->path, ec)) continue; // the directory walk skips these too
+                fs::path link = fs::read_symlink(it->path, ec);
+                if (!ec) target = canonicalPath(it->path.parent_path() / link);
+            }
+            w.str(it->path.string().substr(prefix.size()));
+            w.u8(it->isSymlink ? 1 : 0);
+            w.str(target.string());
+            ++count;
+        }
+        w.patchU32(countAt, count);
+    }
+    w.u32(static_cast<std::uint32_t>(catalogs.size()));
+    for (const auto& [name, id] : catalogs) {
+        w.str(name);
+        w.identity(id);
+    }
+
+    QtIndexSummary summary{indexFile(cacheDir, qt), libs.size(), plugins.size(), modules.size(), catalogs.size()};
+    if (!writeFileAtomic(summary.file, w.buf)) return std::nullopt;
+    return summary;
+}
+
+std::unique_ptr<QtIndex> QtIndex::open(const fs::path& cacheDir, const QtPathsInfo& qt) {
+    const fs::path file = indexFile(cacheDir, qt);
+    std::error_code ec;
+    std::unique_ptr<QtIndex> index(new QtIndex());
+    if (!fs::exists(file, ec) || !index->mapped_.open(file)) return nullptr;
+    const MappedFile& m = index->mapped_;
+    ByteReader r{m.data(), m.size()};
+    if (!r.need(sizeof(kMagic)) || std::memcmp(r.data, kMagic, sizeof(kMagic)) != 0) return nullptr;
+    r.pos += sizeof(kMagic);
+    for (const fs::path* f : qtPathFields(qt)) {
+        if (r.str() != f->string()) return nullptr; // built for another configuration
+    }
+    index->qt_ = qt;
+
+    const std::uint32_t stampCount = r.u32();
+    for (std::uint32_t i = 0; i < stampCount && r.ok; ++i) {
+        const fs::path dir(r.str());
+        const FileIdentity id = r.identity();
+        auto current = cacheIdentity(dir);
+        if (r.ok && (!current || *current != id)) {
+            if (isVerbose()) std::cout << "[qt-index] stale (" << dir << " changed): " << file << "\n";
+            return nullptr;
+        }
+    }
+
+    const std::uint32_t libCount = r.u32();
+    for (std::uint32_t i = 0; i < libCount && r.ok; ++i) {
+        const std::string_view key = r.str();
+        index->libs_[key] = r.pos;
+        r.identity();
+        readArch(r);
+        const std::uint32_t parses = r.u32();
+        for (std::uint32_t j = 0; j < parses && r.ok; ++j) {
+            r.u32();
+            readParseResult(r);
+        }
+    }
+    const std::uint32_t aliasCount = r.u32();
+    for (std::uint32_t i = 0; i < aliasCount && r.ok; ++i) {
+        const std::string_view alias = r.str();
+        index->aliases_[alias] = r.str();
+    }
+    const std::uint32_t pluginCount = r.u32();
+    for (std::uint32_t i = 0; i < pluginCount && r.ok; ++i) index->plugins_.insert(r.str());
+    const std::uint32_t moduleCount = r.u32();
+    for (std::uint32_t i = 0; i < moduleCount && r.ok; ++i) {
+        const std::string_view dir = r.str();
+        index->qmlModules_[dir] = r.pos;
+        const std::uint32_t files = r.u32();
+        for (std::uint32_t j = 0; j < files && r.ok; ++j) {
+            r.str();
+            r.u8();
+            r.str();
+        }
+    }
+    const std::uint32_t catalogCount = r.u32();
+    for (std::uint32_t i = 0; i < catalogCount && r.ok; ++i) {
+        const std::string_view name = r.str();
+        index->catalogs_.emplace_back(name, r.identity());
+    }
+    if (!r.ok) return nullptr; // truncated or corrupt
+
+    if (isVerbose()) {
+        std::cout << "[qt-index] " << index->libs_.size() << " binaries, " << index->plugins_.size() << " plugins, "
+                  << index->qmlModules_.size() << " QML modules from " << file << "\n";
+    }
+    return index;
+}
+
+std::optional<std::string_view> QtIndex::libraryKey(const fs::path& p) const {
+    const std::string s = p.string();
+    auto it = libs_.find(s);
+    if (it != libs_.end()) return it->first;
+    auto alias = aliases_.find(s);
+    if (alias != aliases_.end()) return alias->second;
+    return std::nullopt;
+}
+
+// Reads the identity at the start of the record for `key` and checks it against the file: a library
+// rebuilt in place leaves its directory's stamp alone.
+bool QtIndex::readCurrentRecord(std::string_view key, ByteReader& r) const {
+    const FileIdentity recorded = r.identity();
+    if (!r.ok) return false;
+    auto current = cacheIdentity(fs::path(key));
+    return current && *current == recorded;
+}
+
+std::optional<ParseResult> QtIndex::parsed(const std::string& key, BinaryType type, std::uint32_t cpuType) const {
+    auto it = libs_.find(key);
+    if (it == libs_.end()) return std::nullopt;
+    ByteReader r{mapped_.data(), mapped_.size(), it->second};
+    if (!readCurrentRecord(key, r)) return std::nullopt;
+    const TargetArch arch = readArch(r);
+    if (arch.type != type) return std::nullopt;
+    const std::uint32_t parses = r.u32();
+    for (std::uint32_t i = 0; i < parses && r.ok; ++i) {
+        const std::uint32_t cpu = r.u32();
+        ParseResult pr = readParseResult(r);
+        // A thin file reads the same whichever slice is asked for.
+        if (r.ok && (cpu == cpuType || arch.machines.size() <= 1)) return pr;
+    }
+    return std::nullopt;
+}
+
+std::optional<TargetArch> QtIndex::archOf(const fs::path& p) const {
+    auto key = libraryKey(p);
+    if (!key) return std::nullopt;
+    ByteReader r{mapped_.data(), mapped_.size(), libs_.at(*key)};
+    if (!readCurrentRecord(*key, r)) return std::nullopt;
+    TargetArch arch = readArch(r);
+    if (!r.ok) return std::nullopt;
+    return arch;
+}
+
+std::optional<fs::path> QtIndex::canonicalOf(const fs::path& p) const {
+    auto key = libraryKey(p);
+    if (!key) return std::nullopt;
+    return fs::path(*key);
+}
+
+bool QtIndex::hasPlugin(std::string_view category, std::string_view file) const {
+    std::string rel;
+    rel.reserve(category.size() + 1 + file.size());
+    rel.append(category).append("/").append(file);
+    return plugins_.count(rel) != 0;
+}
+
+std::optional<std::vector<fs::path>> QtIndex::catalogsFor(const std::string& lang) const {
+    std::vector<fs::path> files;
+    const std::string suffix = "_" + lang + ".qm";
+    for (const auto& [name, id] : catalogs_) {
+        if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            fs::path file = qt_.qtInstallTranslations / fs::path(std::string(name));
+            auto current = cacheIdentity(file);
+            if (!current || *current != id) return std::nullopt;
+            files.push_back(std::move(file));
+        }
+    }
+    return files;
+}
+
+std::optional<std::vector<QmlModuleFile>> QtIndex::qmlModuleFiles(const fs::path& moduleDir) const {
+    auto it = qmlModules_.find(moduleDir.string());
+    if (it == qmlModules_.end()) return std::nullopt;
+    ByteReader r{mapped_.data(), mapped_.size(), it->second};
+    const std::uint32_t count = r.u32();
+    if (count > r.size - r.pos) return std::nullopt;
+    std::vector<QmlModuleFile> files(count);
+    for (auto& f : files) {
+        f.relativePath = std::string(r.str());
+        f.isSymlink = r.u8() != 0;
+        f.linkTarget = fs::path(std::string(r.str()));
+    }
+    if (!r.ok) return std::nullopt;
+    return files;
+}
+
+} // namespace cdqt
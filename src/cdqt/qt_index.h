@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "cache_io.h"
+#include "common.h"
+#include "deps_parse.h"
+#include "mapped_file.h"
+#include "object_file.h"
+#include "qt_paths.h"
+
+namespace cdqt {
+
+// One file below an indexed QML module directory. Symlinks carry their resolved target, as the
+// directory walk in copyQmlModules would see them.
+struct QmlModuleFile {
+    std::string relativePath;
+    bool isSymlink = false;
+    fs::path linkTarget; // empty if the link could not be resolved
+};
+
+// Prebuilt description of one Qt installation, written by `crossdeployqt --index-qt` to
+// <cacheDir>/qt-index/<prefix hash>.bin: every binary under the lib, bin, plugin and QML directories
+// with its identity, architecture and parsed dependencies, the plugins by category, the QML modules
+// with their files, and the translation catalogs. Deploys map it and answer these lookups from it
+// instead of walking and parsing the install tree. Directory stamps catch added and removed files;
+// binaries and catalogs are also checked against their own identity (no stat under the Nix store), so a
+// file rebuilt in place is read from disk again.
+class QtIndex {
+public:
+    // The index for the installation described by `qt`; nullptr if there is none, it was built for
+    // other Qt paths, or an indexed directory changed since (directories under the Nix store are
+    // trusted without a stat).
+    static std::unique_ptr<QtIndex> open(const fs::path& cacheDir, const QtPathsInfo& qt);
+
+    // Dependencies of the indexed binary at canonical path `key`, as read for fat Mach-O slice `cpuType`.
+    std::optional<ParseResult> parsed(const std::string& key, BinaryType type, std::uint32_t cpuType) const;
+    // Dependencies and architecture are nullopt once the file's identity differs from the indexed one.
+    // Architecture and canonical path of an indexed binary, looked up by its path or a symlink to it.
+    std::optional<TargetArch> archOf(const fs::path& p) const;
+    std::optional<fs::path> canonicalOf(const fs::path& p) const;
+
+    // Whether QT_INSTALL_PLUGINS/<category>/<file> exists.
+    bool hasPlugin(std::string_view category, std::string_view file) const;
+    // Catalogs in QT_INSTALL_TRANSLATIONS named *_<lang>.qm, sorted; nullopt if one of them changed
+    // since indexing.
+    std::optional<std::vector<fs::path>> catalogsFor(const std::string& lang) const;
+    // Every file below QML module directory `moduleDir`; nullopt if it is not an indexed module.
+    std::optional<std::vector<QmlModuleFile>> qmlModuleFiles(const fs::path& moduleDir) const;
+
+    const QtPathsInfo& qt() const { return qt_; }
+
+private:
+    QtIndex() = default;
+
+    std::optional<std::string_view> libraryKey(const fs::path& p) const;
+    bool readCurrentRecord(std::string_view key, ByteReader& r) const;
+
+    MappedFile mapped_;
+    QtPathsInfo qt_;
+    std::unordered_map<std::string_view, std::size_t> libs_;         // canonical path -> record offset
+    std::unordered_map<std::string_view, std::string_view> aliases_; // other path -> canonical path
+    std::unordered_set<std::string_view> plugins_;                   // "<category>/<file>"
+    std::unordered_map<std::string_view, std::size_t> qmlModules_;   // module dir -> record offset
+    std::vector<std::pair<std::string_view, FileIdentity>> catalogs_; // file names, sorted
+};
+
+struct QtIndexSummary {
+    fs::path file;
+    std::size_t libraries = 0;
+    std::size_t plugins = 0;
+    std::size_t qmlModules = 0;
+    std::size_t catalogs = 0;
+};
+
+// Walks and parses the installation described by `qt` and writes its index into `cacheDir`, using up
+// to `jobs` workers for parsing. nullopt if the index could not be written.
+std::optional<QtIndexSummary> buildQtIndex(const fs::path& cacheDir, const QtPathsInfo& qt, unsigned jobs);
+
+} // namespace cdqt
@@ -1,36 +1,98 @@
 #include "qt_paths.h"
 
+#include <fstream>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "util.h"
 
 namespace cdqt {
 
-QtPathsInfo queryQtPaths() {
+// Assigns the value of a "KEY:VALUE" line to the matching field; other keys (and the /raw, /get
+// variants) are ignored.
+static void applyQueryLine(std::string_view line, QtPathsInfo& info) {
+    const auto colon = line.find(':');
+    if (colon == std::string_view::npos) return;
+    const std::string_view key = line.substr(0, colon);
+    const std::string_view value = trimWhitespace(line.substr(colon + 1));
+    if (value.empty()) return;
+    if (key == "QT_INSTALL_LIBS") info.qtInstallLibs = fs::path(value);
+    else if (key == "QT_INSTALL_BINS") info.qtInstallBins = fs::path(value);
+    else if (key == "QT_INSTALL_PREFIX") info.qtInstallPrefix = fs::path(value);
+    else if (key == "QT_INSTALL_PLUGINS") info.qtInstallPlugins = fs::path(value);
+    else if (key == "QT_INSTALL_QML") info.qtInstallQml = fs::path(value);
+    else if (key == "QT_INSTALL_TRANSLATIONS") info.qtInstallTranslations = fs::path(value);
+}
+
+// Runs `argv` (a single query that prints every property as KEY:VALUE) and collects the paths; false if
+// the tool failed.
+static bool runQuery(const std::vector<std::string>& argv, QtPathsInfo& info) {
+    const ProcessResult res = runProcess(argv, [&](std::string_view line) { applyQueryLine(line, info); });
+    if (res.exitCode == 0) return true;
+    info = QtPathsInfo();
+    return false;
+}
+
+// qmake-style tools do not understand `--query`; derive the layout from the qt.conf next to the tool
+// instead, without starting it ([Paths] entries are relative to Prefix, which is relative to the tool's
+// directory). nullopt if there is no qt.conf: the layout is then compiled into qmake.
+static std::optional<QtPathsInfo> readQtConf(const fs::path& tool) {
+    const fs::path binDir = tool.parent_path();
+    std::string prefix = "..";
+    std::string libs = "lib", bins = "bin", plugins = "plugins", qml = "qml", translations = "translations";
+
+    std::ifstream in(binDir / "qt.conf");
+    if (!in) return std::nullopt;
+    std::string line;
+    bool inPaths = false;
+    while (std::getline(in, line)) {
+        std::string_view l = trimWhitespace(line);
+        if (l.empty() || l.front() == '#' || l.front() == ';') continue;
+        if (l.front() == '[') { inPaths = l == "[Paths]"; continue; }
+        if (!inPaths) continue;
+        const auto eq = l.find('=');
+        if (eq == std::string_view::npos) continue;
+        const std::string_view key = trimWhitespace(l.substr(0, eq));
+        const std::string value(trimWhitespace(l.substr(eq + 1)));
+        if (key == "Prefix") prefix = value;
+        else if (key == "Libraries") libs = value;
+        else if (key == "Binaries") bins = value;
+        else if (key == "Plugins") plugins = value;
+        else if (key == "QmlImports" || key == "Qml2Imports") qml = value;
+        else if (key == "Translations") translations = value;
+    }
+
+    std::error_code ec;
+    fs::path root = fs::weakly_canonical(binDir / prefix, ec);
+    if (ec) root = binDir / prefix;
+    QtPathsInfo info;
+    info.qtInstallPrefix = root;
+    info.qtInstallLibs = root / libs;
+    info.qtInstallBins = root / bins;
+    info.qtInstallPlugins = root / plugins;
+    info.qtInstallQml = root / qml;
+    info.qtInstallTranslations = root / translations;
+    return info;
+}
+
+static QtPathsInfo fetchQtPaths() {
     QtPathsInfo info;
-    int code = 0;
     std::string qtpathsBin = getEnv("QTPATHS_BIN");
     if (qtpathsBin.empty()) qtpathsBin = "qtpaths";
 
-    auto trim = [](std::string s) {
-        while (!s.empty() && (s.back() == '\n' || s.back() == '\r' || s.back() == ' ' || s.back() == '\t')) s.pop_back();
-        size_t i = 0;
-        while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) ++i;
-        return s.substr(i);
-    };
-
-    std::string libs = runCommand(qtpathsBin + " --query QT_INSTALL_LIBS", code);
-    if (code == 0) info.qtInstallLibs = fs::path(trim(libs));
-    std::string bins = runCommand(qtpathsBin + " --query QT_INSTALL_BINS", code);
-    if (code == 0) info.qtInstallBins = fs::path(trim(bins));
-    std::string prefix = runCommand(qtpathsBin + " --query QT_INSTALL_PREFIX", code);
-    if (code == 0) info.qtInstallPrefix = fs::path(trim(prefix));
-    std::string plugins = runCommand(qtpathsBin + " --query QT_INSTALL_PLUGINS", code);
-    if (code == 0) info.qtInstallPlugins = fs::path(trim(plugins));
-    std::string qml = runCommand(qtpathsBin + " --query QT_INSTALL_QML", code);
-    if (code == 0) info.qtInstallQml = fs::path(trim(qml));
-    std::string trans = runCommand(qtpathsBin + " --query QT_INSTALL_TRANSLATIONS", code);
-    if (code == 0) info.qtInstallTranslations = fs::path(trim(trans));
+    if (fs::path(qtpathsBin).filename().string().find("qmake") != std::string::npos) {
+        const auto tool = findProgram(qtpathsBin);
+        std::optional<QtPathsInfo> conf;
+        if (tool) conf = readQtConf(*tool);
+        if (conf) info = *conf;
+        else runQuery({qtpathsBin, "-query"}, info);
+    } else {
+        // One `--query` without a key prints every property as KEY:VALUE.
+        runQuery({qtpathsBin, "--query"}, info);
+    }
 
     // Validate directories exist; otherwise leave empty
     std::error_code ec;
@@ -41,6 +103,11 @@ QtPathsInfo queryQtPaths() {
     return info;
 }
 
-} // namespace cdqt
-
+const QtPathsInfo& queryQtPaths() {
+    static std::once_flag once;
+    static QtPathsInfo info;
+    std::call_once(once, [] { info = fetchQtPaths(); });
+    return info;
+}
 
+} // namespace cdqt
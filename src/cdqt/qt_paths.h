@@ -15,7 +15,9 @@ struct QtPathsInfo {
     fs::path qtInstallTranslations;
 };
 
-QtPathsInfo queryQtPaths();
+// Queried once per process (a single `qtpaths --query`, or qt.conf for a qmake-style QTPATHS_BIN)
+// and shared by every phase afterwards.
+const QtPathsInfo& queryQtPaths();
 
 } // namespace cdqt
 
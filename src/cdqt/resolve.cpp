@@ -4,10 +4,14 @@
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <unordered_map>
 
 #include "deps_parse.h"
+#include "qt_index.h"
 #include "util.h"
 
 namespace cdqt {
@@ -28,6 +32,7 @@ void addSearchDir(ResolveContext& ctx, const fs::path& dir) {
 
 void ensureEnvForResolution(ResolveContext& ctx) {
     addSearchDirInternal(ctx, ctx.plan.binaryPath.parent_path());
+    ctx.arch = peekTargetArch(ctx.plan.binaryPath);
 
     const auto qtLibs = ctx.qt.qtInstallLibs;
     const auto qtBins = ctx.qt.qtInstallBins;
@@ -110,19 +115,119 @@ static std::string expandElfOrigin(std::string p, const fs::path& subject) {
 
 static fs::path expandMachOToken(const std::string& p, const fs::path& subjectBin, const fs::path& mainExe) {
     fs::path dir = subjectBin.parent_path();
-    if (p.rfind("@loader_path/", 0) == 0)        return fs::weakly_canonical(dir / p.substr(13));
-    if (p.rfind("@executable_path/", 0) == 0)    return fs::weakly_canonical(mainExe.parent_path() / p.substr(17));
+    if (p.rfind("@loader_path/", 0) == 0)        return canonicalPath(dir / p.substr(13));
+    if (p.rfind("@executable_path/", 0) == 0)    return canonicalPath(mainExe.parent_path() / p.substr(17));
     return fs::path(p);
 }
 
-std::optional<fs::path> findLibrary(const std::string& nameOrPath, const ResolveContext& ctx) {
+std::uint32_t targetMachOCpuType(const ResolveContext& ctx) {
+    if (!ctx.arch || ctx.arch->type != BinaryType::MACHO || ctx.arch->machines.empty()) return 0;
+    return ctx.arch->machines.front();
+}
+
+// An existing file built for the main binary's architecture. Like the loader, resolution skips
+// wrong-architecture libraries and keeps searching, so their subtrees are never parsed or deployed.
+static bool isUsableCandidate(const fs::path& cand, const ResolveContext& ctx, const char* logTag) {
+    if (ctx.qtIndex) {
+        if (auto arch = ctx.qtIndex->archOf(cand)) {
+            if (!ctx.arch || ctx.arch->accepts(*arch)) return true;
+            if (isVerbose()) logLine("[", logTag, "]     skip (architecture mismatch): ", cand);
+            return false;
+        }
+    }
+    // The existence and header of a Nix store file never change; look each one up once per process.
+    struct Probe { bool exists; std::optional<TargetArch> arch; };
+    static std::mutex storeMutex;
+    static std::unordered_map<std::string, Probe> storeProbes;
+    auto probe = [&]() -> Probe {
+        std::error_code ec;
+        if (!fs::exists(cand, ec)) return {false, std::nullopt};
+        return {true, ctx.arch ? peekTargetArch(cand) : std::nullopt};
+    };
+    Probe pr;
+    if (ctx.arch && isNixStorePath(cand)) {
+        std::unique_lock<std::mutex> lock(storeMutex);
+        auto it = storeProbes.find(cand.native());
+        if (it == storeProbes.end()) {
+            lock.unlock();
+            pr = probe();
+            lock.lock();
+            storeProbes.emplace(cand.native(), pr);
+        } else {
+            pr = it->second;
+        }
+    } else {
+        pr = probe();
+    }
+    if (!pr.exists) return false;
+    if (!ctx.arch) return true;
+    const auto& arch = pr.arch;
+    if (arch && ctx.arch->accepts(*arch)) return true;
+    if (isVerbose()) logLine("[", logTag, "]     skip (architecture mismatch): ", cand);
+    return false;
+}
+
+// Path a usable candidate is recorded under; indexed Qt binaries are looked up rather than canonicalised.
+static fs::path candidatePath(const fs::path& cand, const ResolveContext& ctx) {
+    if (ctx.qtIndex) {
+        if (auto p = ctx.qtIndex->canonicalOf(cand)) return *p;
+    }
+    return canonicalPath(cand);
+}
+
+static std::string lowerAscii(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return std::tolower(c); });
+    return s;
+}
+
+// Directory entry names of `dir` -> name on disk, read once per process on first use. With `foldCase`
+// (PE, whose loader matches DLL names case-insensitively) the keys are lowercased.
+using DirListing = std::unordered_map<std::string, std::string>;
+static const DirListing& searchDirListing(const fs::path& dir, bool foldCase) {
+    struct Entry {
+        std::once_flag once;
+        DirListing names;
+    };
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::unique_ptr<Entry>> listings;
+    Entry* entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& slot = listings[(foldCase ? "i:" : "s:") + dir.string()];
+        if (!slot) slot = std::make_unique<Entry>();
+        entry = slot.get();
+    }
+    // Listed outside the map lock, so other directories can be looked up meanwhile.
+    std::call_once(entry->once, [&] {
+        std::error_code ec;
+        for (auto it = fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+             !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            std::string name = it->path().filename().string();
+            entry->names.emplace(foldCase ? lowerAscii(name) : name, name);
+        }
+    });
+    return entry->names;
+}
+
+std::optional<fs::path> findLibrary(const std::string& nameOrPath, const ResolveContext& ctx, const char* logTag) {
     fs::path p(nameOrPath);
-    std::error_code ec;
-    if (p.is_absolute() && fs::exists(p, ec)) return fs::weakly_canonical(p, ec);
+    if (p.is_absolute() && isUsableCandidate(p, ctx, logTag)) return candidatePath(p, ctx);
+    // A bare file name costs one hash probe per search directory; only names with a directory part
+    // (e.g. "QtCore.framework/Versions/A/QtCore") are probed on disk.
+    const bool bareName = nameOrPath.find_first_of("/\\") == std::string::npos;
+    const bool foldCase = ctx.plan.type == BinaryType::PE;
+    const std::string key = foldCase ? lowerAscii(nameOrPath) : nameOrPath;
     for (const auto& dir : ctx.searchDirs) {
-        fs::path cand = dir / nameOrPath;
-        std::error_code ec2;
-        if (fs::exists(cand, ec2)) return fs::weakly_canonical(cand, ec2);
+        fs::path cand;
+        if (bareName) {
+            const DirListing& names = searchDirListing(dir, foldCase);
+            auto it = names.find(key);
+            if (it == names.end()) continue;
+            cand = dir / it->second;
+        } else {
+            cand = dir / nameOrPath;
+        }
+        if (isUsableCandidate(cand, ctx, logTag)) return candidatePath(cand, ctx);
     }
     return std::nullopt;
 }
@@ -130,41 +235,39 @@ std::optional<fs::path> findLibrary(const std::string& nameOrPath, const Resolve
 static std::optional<fs::path> resolveELFRef(const std::string& ref,
                                              const fs::path& subject,
                                              const std::vector<std::string>& subjectRpaths,
-                                             const ResolveContext& ctx) {
-    std::error_code ec;
+                                             const ResolveContext& ctx,
+                                             const char* logTag) {
     fs::path p(ref);
-    if (p.is_absolute() && fs::exists(p, ec)) return fs::weakly_canonical(p, ec);
+    if (p.is_absolute() && isUsableCandidate(p, ctx, logTag)) return candidatePath(p, ctx);
     for (const auto& rp : subjectRpaths) {
         fs::path base = expandElfOrigin(rp, subject);
         fs::path cand = base / ref;
-        std::error_code ec2;
-        if (fs::exists(cand, ec2)) return fs::weakly_canonical(cand, ec2);
+        if (isUsableCandidate(cand, ctx, logTag)) return candidatePath(cand, ctx);
     }
-    return findLibrary(ref, ctx);
+    return findLibrary(ref, ctx, logTag);
 }
 
 static std::optional<fs::path> resolveMachORef(const std::string& ref,
                                                const fs::path& subject,
                                                const std::vector<std::string>& subjectRpaths,
                                                const ResolveContext& ctx,
-                                               const fs::path& mainExe) {
-    std::error_code ec;
+                                               const fs::path& mainExe,
+                                               const char* logTag) {
     fs::path p(ref);
-    if (p.is_absolute() && fs::exists(p, ec)) return fs::weakly_canonical(p, ec);
+    if (p.is_absolute() && isUsableCandidate(p, ctx, logTag)) return candidatePath(p, ctx);
     if (ref.rfind("@loader_path/", 0) == 0 || ref.rfind("@executable_path/", 0) == 0) {
         fs::path cand = expandMachOToken(ref, subject, mainExe);
-        if (fs::exists(cand, ec)) return fs::weakly_canonical(cand, ec);
+        if (isUsableCandidate(cand, ctx, logTag)) return candidatePath(cand, ctx);
     }
     if (ref.rfind("@rpath/", 0) == 0) {
         const std::string tail = ref.substr(7);
         for (const auto& rp : subjectRpaths) {
             fs::path base = expandMachOToken(rp, subject, mainExe);
             fs::path cand = base / tail;
-            std::error_code ec2;
-            if (fs::exists(cand, ec2)) return fs::weakly_canonical(cand, ec2);
+            if (isUsableCandidate(cand, ctx, logTag)) return candidatePath(cand, ctx);
         }
     }
-    return findLibrary(ref, ctx);
+    return findLibrary(ref, ctx, logTag);
 }
 
 std::optional<fs::path> resolveRef(BinaryType type,
@@ -173,15 +276,51 @@ std::optional<fs::path> resolveRef(BinaryType type,
                                    const ParseResult& subjectParsed,
                                    const ResolveContext& ctx,
                                    ParseCache& cache,
-                                   const fs::path& mainExe) {
+                                   const fs::path& mainExe,
+                                   const char* logTag) {
     if (type == BinaryType::ELF) {
-        return resolveELFRef(ref, subject, subjectParsed.rpaths, ctx);
+        return resolveELFRef(ref, subject, subjectParsed.rpaths, ctx, logTag);
     }
     if (type == BinaryType::PE) {
-        return findLibrary(ref, ctx);
+        return findLibrary(ref, ctx, logTag);
     }
     const auto& rps = machoRpathsFor(subject, cache);
-    return resolveMachORef(ref, subject, rps, ctx, mainExe);
+    return resolveMachORef(ref, subject, rps, ctx, mainExe, logTag);
+}
+
+// The rpaths resolveRef consults for relative ELF names and @rpath references, expanded for `subject`.
+static std::string expandedRpaths(BinaryType type,
+                                  const fs::path& subject,
+                                  const std::vector<std::string>& rpaths,
+                                  const fs::path& mainExe) {
+    std::string out;
+    for (const auto& rp : rpaths) {
+        out += type == BinaryType::ELF ? expandElfOrigin(rp, subject) : expandMachOToken(rp, subject, mainExe).string();
+        out += '\n';
+    }
+    return out;
+}
+
+std::uint32_t ResolutionCache::intern(const std::string& context) {
+    if (context.empty()) return 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return contexts_.emplace(context, static_cast<std::uint32_t>(contexts_.size() + 1)).first->second;
+}
+
+const ResolutionCache::Outcome* ResolutionCache::lookup(std::uint32_t context, const std::string& ref) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = outcomes_.find(Key{context, ref});
+    if (it == outcomes_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    return &it->second;
+}
+
+const ResolutionCache::Outcome* ResolutionCache::remember(std::uint32_t context, const std::string& ref, Outcome outcome) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return &outcomes_.emplace(Key{context, ref}, std::move(outcome)).first->second;
 }
 
 bool isQtLibraryName(const std::string& name) {
@@ -224,60 +363,174 @@ bool shouldDeployLibrary(const fs::path& libPath, const std::string&, BinaryType
     }
 }
 
-std::vector<fs::path> resolveAndRecurse(const DeployPlan& plan) {
-    ResolveContext ctx{plan, queryQtPaths(), {}, {}, {}, {}};
-    ensureEnvForResolution(ctx);
+namespace {
 
-    ParseCache cache;
-    const ParseResult& pr = parseDepsCached(plan.binaryPath, plan.type, cache);
+// State of one dependency closure. Every node is a job on the pool: it is parsed with the native
+// readers and its dependencies are resolved, and each newly seen library becomes another job. Nodes
+// only objdump/llvm-otool can read are set aside and parsed in batches whenever the pool runs dry.
+class ClosureWalk {
+public:
+    ClosureWalk(DeploySession& session, bool requireQt, const char* tag)
+        : ctx_(session.ctx), cache_(session.cache), resolutions_(session.resolutions), known_(session.resolved), requireQt_(requireQt), tag_(tag),
+          visited_(session.resolved.begin(), session.resolved.end()), pool_(session.ctx.plan.jobs) {}
 
-    std::vector<fs::path> stack;
-    for (const auto& dep : pr.dependencies) {
-        std::optional<fs::path> found = resolveRef(plan.type, dep, plan.binaryPath, pr, ctx, cache, plan.binaryPath);
-        if (found) {
-            if (shouldDeployLibrary(*found, dep, plan.type, ctx)) stack.push_back(*found);
-        } else if (isQtLibraryName(dep)) {
-            throw std::runtime_error("Required Qt library not found in search paths: " + dep);
+    std::vector<fs::path> run(const std::vector<fs::path>& roots) {
+        std::vector<std::string> keys;
+        for (const auto& root : roots) keys.push_back(canonicalKey(root));
+        roots_.insert(keys.begin(), keys.end()); // complete before the first job reads it
+        for (std::size_t i = 0; i < roots.size(); ++i) {
+            if (markVisited(keys[i])) schedule(roots[i]);
         }
+        for (;;) {
+            pool_.wait();
+            std::vector<fs::path> pending;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (error_) std::rethrow_exception(error_);
+                pending.swap(needTool_);
+            }
+            if (pending.empty()) break;
+            // Sorted so the batches, like the result, do not depend on thread timing.
+            std::sort(pending.begin(), pending.end());
+            for (std::size_t start = 0; start < pending.size(); start += kToolBatchSize) {
+                std::vector<fs::path> batch(pending.begin() + start,
+                                            pending.begin() + std::min(pending.size(), start + kToolBatchSize));
+                submit([this, batch = std::move(batch)] {
+                    parseDepsWithTool(batch, ctx_.plan.type, cache_);
+                    for (const auto& node : batch) expand(node, parseDepsCached(node, ctx_.plan.type, cache_));
+                });
+            }
+        }
+        return {found_.begin(), found_.end()};
     }
 
-    std::unordered_set<std::string> visited;
-    while (!stack.empty()) {
-        fs::path cur = stack.back();
-        stack.pop_back();
-        if (isVerbose()) std::cout << "[resolve] Inspect: " << cur << "\n";
-        std::error_code ec;
-        fs::path canon = fs::weakly_canonical(cur, ec);
-        std::string key = ec ? cur.string() : canon.string();
-        if (visited.count(key)) continue;
-        visited.insert(key);
-
-        const ParseResult& prChild = parseDepsCached(cur, plan.type, cache);
-        for (const auto& dep : prChild.dependencies) {
-            if (isVerbose()) std::cout << "[resolve]   dep: " << dep << "\n";
-            std::optional<fs::path> found = resolveRef(plan.type, dep, cur, prChild, ctx, cache, plan.binaryPath);
-            if (found) {
-                if (shouldDeployLibrary(*found, dep, plan.type, ctx)) {
-                    if (isVerbose()) std::cout << "[resolve]     push: " << *found << "\n";
-                    stack.push_back(*found);
-                }
-            } else {
-                if (isQtLibraryName(dep)) {
+private:
+    // Runs `job` on the pool; the first exception any job throws is rethrown by run().
+    template <class F>
+    void submit(F job) {
+        pool_.submit([this, job = std::move(job)] {
+            try {
+                job();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+        });
+    }
+
+    bool markVisited(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return visited_.insert(key).second;
+    }
+
+    void schedule(fs::path node) {
+        submit([this, node = std::move(node)] { visit(node); });
+    }
+
+    void visit(const fs::path& node) {
+        if (isVerbose()) logLine("[", tag_, "] Inspect: ", node);
+        const ParseResult* pr = parseDepsNative(node, ctx_.plan.type, cache_);
+        if (!pr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            needTool_.push_back(node);
+            return;
+        }
+        expand(node, *pr);
+    }
+
+    void expand(const fs::path& node, const ParseResult& pr) {
+        const BinaryType type = ctx_.plan.type;
+        const fs::path& mainExe = ctx_.plan.binaryPath;
+        const std::uint32_t rpathsId =
+            type == BinaryType::PE ? 0 : resolutions_.intern(expandedRpaths(type, node, pr.rpaths, mainExe));
+        for (const auto& dep : pr.dependencies) {
+            if (isVerbose()) logLine("[", tag_, "]   dep: ", dep);
+            const std::uint32_t context = refContext(type, dep, node, rpathsId);
+            const ResolutionCache::Outcome* outcome = resolutions_.lookup(context, dep);
+            if (!outcome) outcome = resolveUncached(type, dep, node, pr, context);
+            if (outcome->status == ResolutionCache::Status::Unresolved) {
+                if (requireQt_ && isQtLibraryName(dep)) {
                     throw std::runtime_error("Required Qt library not found in search paths: " + dep);
                 }
+                continue;
+            }
+            if (outcome->status == ResolutionCache::Status::Rejected) continue;
+            const fs::path& found = outcome->path;
+            if (isVerbose()) logLine("[", tag_, "]     push: ", found);
+            bool fresh;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!known_.count(found.string()) && !roots_.count(found.string())) found_.insert(found.string());
+                fresh = visited_.insert(found.string()).second;
             }
+            if (fresh) schedule(found);
         }
     }
 
-    std::vector<fs::path> libs;
-    libs.reserve(visited.size());
-    for (const auto& k : visited) {
-        if (k == plan.binaryPath.string()) continue;
-        libs.emplace_back(k);
+    // Interned id of what decides how `ref` resolves from `node` besides the search directories:
+    // relative ELF names and @rpath references depend on its rpaths, @loader_path ones on its directory.
+    std::uint32_t refContext(BinaryType type, const std::string& ref, const fs::path& node, std::uint32_t rpathsId) {
+        if (type == BinaryType::ELF && !fs::path(ref).is_absolute()) return rpathsId;
+        if (type == BinaryType::MACHO) {
+            if (ref.rfind("@rpath/", 0) == 0) return rpathsId;
+            if (ref.rfind("@loader_path/", 0) == 0) return resolutions_.intern("@loader_path=" + node.parent_path().string());
+        }
+        return 0;
     }
-    return libs;
+
+    const ResolutionCache::Outcome* resolveUncached(BinaryType type, const std::string& ref, const fs::path& node,
+                                                    const ParseResult& pr, std::uint32_t context) {
+        ResolutionCache::Outcome outcome{ResolutionCache::Status::Unresolved, {}};
+        if (auto found = resolveRef(type, ref, node, pr, ctx_, cache_, ctx_.plan.binaryPath, tag_)) {
+            outcome.status = shouldDeployLibrary(*found, ref, type, ctx_) ? ResolutionCache::Status::Deployable
+                                                                          : ResolutionCache::Status::Rejected;
+            outcome.path = std::move(*found);
+        }
+        return resolutions_.remember(context, ref, std::move(outcome));
+    }
+
+    const ResolveContext& ctx_;
+    ParseCache& cache_;
+    ResolutionCache& resolutions_;
+    const std::set<std::string>& known_; // resolved by earlier phases; neither walked nor returned again
+    const bool requireQt_;
+    const char* tag_;
+
+    std::mutex mutex_; // guards everything below
+    std::unordered_set<std::string> visited_;
+    std::unordered_set<std::string> roots_; // never returned as libraries, even when another root needs them
+    std::set<std::string> found_;
+    std::vector<fs::path> needTool_;
+    std::exception_ptr error_;
+
+    JobPool pool_; // declared last, so its workers are joined before the state above goes away
+};
+
+} // namespace
+
+DeploySession::DeploySession(const DeployPlan& plan, PersistentParseCache* persistent, const QtIndex* qtIndex)
+    : ctx{plan, queryQtPaths(), {}, {}, {}, {}, {}, qtIndex} {
+    ensureEnvForResolution(ctx);
+    cache.machoCpuType = targetMachOCpuType(ctx);
+    cache.persistent = persistent;
+    cache.index = qtIndex;
 }
 
-} // namespace cdqt
+std::vector<fs::path> dependencyClosure(const std::vector<fs::path>& roots, DeploySession& session, bool requireQt,
+                                        const char* logTag) {
+    const auto before = session.resolutions.hitsAndMisses();
+    std::vector<fs::path> found = ClosureWalk(session, requireQt, logTag).run(roots);
+    for (const auto& p : found) session.resolved.insert(p.string());
+    if (isVerbose()) {
+        const auto after = session.resolutions.hitsAndMisses();
+        std::cout << "[" << logTag << "] Resolution cache: " << (after.first - before.first) << " hits, "
+                  << (after.second - before.second) << " misses\n";
+    }
+    return found;
+}
 
+std::vector<fs::path> resolveAndRecurse(DeploySession& session) {
+    return dependencyClosure({session.ctx.plan.binaryPath}, session, true, "resolve");
+}
 
+} // namespace cdqt
@@ -1,17 +1,23 @@
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include <optional>
 #include <set>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "common.h"
+#include "deps_parse.h"
+#include "object_file.h"
 #include "qt_paths.h"
 
 namespace cdqt {
 
-struct ParseResult;
-struct ParseCache;
+class PersistentParseCache;
+class QtIndex;
 
 struct ResolveContext {
     DeployPlan plan;
@@ -20,12 +26,80 @@ struct ResolveContext {
     std::vector<fs::path> qmlImportPaths;    // directories for QML imports
     std::vector<fs::path> cliQmlRoots;       // from --qml-root and env
     std::unordered_set<std::string> searchDirSet; // for dedup
+    std::optional<TargetArch> arch;          // of the main binary; dependency candidates must match it
+    const QtIndex* qtIndex = nullptr;        // prebuilt index of the Qt install, if one was loaded
+};
+
+// Outcomes of resolving dependency references, shared by every closure of a deploy. An outcome is
+// keyed by the reference and an interned id of whatever else decides how it resolves from its subject:
+// the expanded rpath list or the loader directory, 0 if neither applies. Libraries with identical
+// RUNPATH/LC_RPATH lists thus share their lookups, and each repeated one costs a single hash lookup.
+class ResolutionCache {
+public:
+    enum class Status {
+        Deployable, // found, and shouldDeployLibrary accepts it
+        Rejected,   // found, but shouldDeployLibrary turns it down (system library)
+        Unresolved, // not found in any applicable directory
+    };
+    struct Outcome {
+        Status status;
+        fs::path path; // empty if Unresolved
+    };
+
+    // Id of `context`; the empty context is 0.
+    std::uint32_t intern(const std::string& context);
+    // Entries are never removed, so a returned outcome stays valid for the cache's lifetime.
+    const Outcome* lookup(std::uint32_t context, const std::string& ref);
+    const Outcome* remember(std::uint32_t context, const std::string& ref, Outcome outcome);
+
+    std::pair<std::size_t, std::size_t> hitsAndMisses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {hits_, misses_};
+    }
+
+private:
+    struct Key {
+        std::uint32_t context;
+        std::string ref;
+        bool operator==(const Key& o) const { return context == o.context && ref == o.ref; }
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const {
+            return std::hash<std::string>()(k.ref) ^ (static_cast<std::size_t>(k.context) * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::uint32_t> contexts_;
+    std::unordered_map<Key, Outcome, KeyHash> outcomes_;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+};
+
+// State shared by every phase of one deploy, created once in deploy(): the resolution context
+// (ensureEnvForResolution runs once), one ParseCache, and the libraries resolved so far, so each later
+// dependency closure only does work for libraries no earlier phase has seen.
+struct DeploySession {
+    DeploySession(const DeployPlan& plan, PersistentParseCache* persistent, const QtIndex* qtIndex);
+    DeploySession(const DeploySession&) = delete;
+    DeploySession& operator=(const DeploySession&) = delete;
+
+    ResolveContext ctx;
+    ParseCache cache;
+    ResolutionCache resolutions;
+    std::set<std::string> resolved; // canonical paths of every library found so far
 };
 
 void addSearchDir(ResolveContext& ctx, const fs::path& dir);
 void ensureEnvForResolution(ResolveContext& ctx);
 
-std::optional<fs::path> findLibrary(const std::string& nameOrPath, const ResolveContext& ctx);
+// Fat Mach-O slice the dependency readers should use: the main binary's cputype, or its first slice's
+// when it is fat. 0 when the main binary is not Mach-O.
+std::uint32_t targetMachOCpuType(const ResolveContext& ctx);
+
+// `logTag` prefixes the verbose lines, as in the closure walk that asked.
+std::optional<fs::path> findLibrary(const std::string& nameOrPath, const ResolveContext& ctx,
+                                   const char* logTag = "resolve");
 
 bool isQtLibraryName(const std::string& name);
 bool shouldDeployLibrary(const fs::path& libPath, const std::string& sonameOrDll, BinaryType type, const ResolveContext& ctx);
@@ -38,10 +112,17 @@ std::optional<fs::path> resolveRef(BinaryType type,
                                    const ParseResult& subjectParsed,
                                    const ResolveContext& ctx,
                                    ParseCache& cache,
-                                   const fs::path& mainExe);
+                                   const fs::path& mainExe,
+                                   const char* logTag = "resolve");
 
-std::vector<fs::path> resolveAndRecurse(const DeployPlan& plan);
-
-} // namespace cdqt
+// Libraries reachable from `roots` through dependencies that shouldDeployLibrary accepts and that are
+// not in session.resolved yet, sorted; they are added to it. Libraries resolved by an earlier phase are
+// not walked again. Nodes are parsed and resolved concurrently on plan.jobs workers; the result does
+// not depend on their timing. With `requireQt`, a Qt library that cannot be found is an error.
+std::vector<fs::path> dependencyClosure(const std::vector<fs::path>& roots, DeploySession& session, bool requireQt,
+                                        const char* logTag);
 
+// The main binary's dependency closure.
+std::vector<fs::path> resolveAndRecurse(DeploySession& session);
 
+} // namespace cdqt
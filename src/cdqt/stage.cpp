@@ -5,12 +5,22 @@
 #include <unordered_set>
 
 #include "deps_parse.h"
+#include "elf_patch.h"
 #include "fs_ops.h"
+#include "macho_edit.h"
+#include "qt_index.h"
 #include "qt_paths.h"
 #include "util.h"
 
 namespace cdqt {
 
+// Whether <root>/<category>/<file> exists; for the indexed Qt plugin directory the index answers.
+static bool pluginExists(const ResolveContext& ctx, const fs::path& root, const char* category, const std::string& file) {
+    if (ctx.qtIndex && root == ctx.qtIndex->qt().qtInstallPlugins) return ctx.qtIndex->hasPlugin(category, file);
+    std::error_code ec;
+    return fs::exists(root / category / file, ec);
+}
+
 void copyResolvedForPE(const DeployPlan& plan, const std::vector<fs::path>& libs) {
     for (const auto& lib : libs) {
         fs::path dest = plan.outputRoot / lib.filename();
@@ -61,11 +71,11 @@ void copyPluginsPE(const ResolveContext& ctx, const DeployPlan& plan, const std:
 
     for (const auto& src : pluginRoots) {
         fs::path platformDll = src / "platforms" / "qwindows.dll";
-        if (!fs::exists(platformDll)) continue;
+        if (!pluginExists(ctx, src, "platforms", "qwindows.dll")) continue;
         copyFileOverwrite(platformDll, plan.outputRoot / "plugins" / "platforms" / platformDll.filename());
         for (const char* name : {"qjpeg.dll","qico.dll","qgif.dll","qpng.dll"}) {
             fs::path p = src / "imageformats" / name;
-            if (fs::exists(p)) copyFileOverwrite(p, plan.outputRoot / "plugins" / "imageformats" / p.filename());
+            if (pluginExists(ctx, src, "imageformats", name)) copyFileOverwrite(p, plan.outputRoot / "plugins" / "imageformats" / p.filename());
         }
         break;
     }
@@ -102,19 +112,46 @@ void copyResolvedForELF(const DeployPlan& plan, const std::vector<fs::path>& lib
     writeQtConfIfNeeded(plan);
 }
 
+// Rewrites RUNPATH natively. patchelf, when it is on PATH, is only tried for the rare layouts into which
+// setElfRunpath cannot add a segment.
+static bool setRunpathELF(const fs::path& file, const std::string& runpath) {
+    switch (setElfRunpath(file, runpath)) {
+        case RunpathEdit::Unchanged:
+            return true;
+        case RunpathEdit::Patched:
+        case RunpathEdit::Relocated:
+            if (isVerbose()) std::cout << "[runpath] " << file << " -> " << runpath << "\n";
+            return true;
+        case RunpathEdit::Failed:
+            return false;
+        case RunpathEdit::NoRoom:
+            break;
+    }
+    if (!findProgram("patchelf")) return false;
+    const ProcessResult res = runProcess({"patchelf", "--set-rpath", runpath, file.string()});
+    if (res.exitCode != 0 && !res.err.empty()) std::cerr << res.err;
+    return res.exitCode == 0;
+}
+
 void copyPluginsELF(const ResolveContext& ctx, const DeployPlan& plan) {
     if (ctx.qt.qtInstallPlugins.empty()) return;
     const fs::path src = ctx.qt.qtInstallPlugins;
     fs::path platformSo = src / "platforms" / "libqxcb.so";
-    if (fs::exists(platformSo)) copyFileOverwrite(platformSo, plan.outputRoot / "usr" / "plugins" / "platforms" / platformSo.filename());
+    if (pluginExists(ctx, src, "platforms", "libqxcb.so")) copyFileOverwrite(platformSo, plan.outputRoot / "usr" / "plugins" / "platforms" / platformSo.filename());
     for (const char* name : {"libqjpeg.so","libqico.so","libqgif.so","libqpng.so"}) {
         fs::path p = src / "imageformats" / name;
-        if (fs::exists(p)) copyFileOverwrite(p, plan.outputRoot / "usr" / "plugins" / "imageformats" / p.filename());
+        if (pluginExists(ctx, src, "imageformats", name)) copyFileOverwrite(p, plan.outputRoot / "usr" / "plugins" / "imageformats" / p.filename());
+    }
+    const fs::path pluginsDir = plan.outputRoot / "usr" / "plugins";
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(pluginsDir, fs::directory_options::skip_permission_denied, ec);
+         it != fs::recursive_directory_iterator(); ++it) {
+        if (!it->is_regular_file(ec) || it->is_symlink(ec)) continue;
+        if (it->path().filename().string().find(".so") == std::string::npos) continue;
+        if (!setRunpathELF(it->path(), "$ORIGIN/../../lib") && isVerbose()) {
+            std::cout << "[runpath] failed to set RUNPATH on " << it->path() << "\n";
+        }
     }
-    int code = 0;
-    std::string pluginsDir = (plan.outputRoot / "usr" / "plugins").string();
-    std::string cmd = std::string("find ") + shellEscape(pluginsDir) + " -type f -name '*.so*' -exec patchelf --set-rpath '$ORIGIN/../../lib' {} +";
-    runCommand(cmd, code);
 }
 
 void copyMainAndPatchELF(const DeployPlan& plan) {
@@ -123,11 +160,8 @@ void copyMainAndPatchELF(const DeployPlan& plan) {
         std::cerr << "Warning: failed to copy main binary: " << plan.binaryPath << " -> " << dest << "\n";
         return;
     }
-    int code = 0;
-    std::string cmd = std::string("patchelf --set-rpath '$ORIGIN/../lib' ") + shellEscape(dest.string());
-    runCommand(cmd, code);
-    if (code != 0) {
-        std::cerr << "Warning: patchelf failed to set RUNPATH on " << dest << "\n";
+    if (!setRunpathELF(dest, "$ORIGIN/../lib")) {
+        std::cerr << "Warning: failed to set RUNPATH on " << dest << "\n";
     }
 }
 
@@ -170,21 +204,23 @@ void copyPluginsMachO(const ResolveContext& ctx, const DeployPlan& plan) {
     const fs::path src = ctx.qt.qtInstallPlugins;
     fs::path dstBase = plan.outputRoot / "Contents" / "PlugIns";
     fs::path cocoa = src / "platforms" / "libqcocoa.dylib";
-    if (fs::exists(cocoa)) copyFileOverwrite(cocoa, dstBase / "platforms" / cocoa.filename());
+    if (pluginExists(ctx, src, "platforms", "libqcocoa.dylib")) copyFileOverwrite(cocoa, dstBase / "platforms" / cocoa.filename());
     for (const char* name : {"libqjpeg.dylib","libqico.dylib","libqgif.dylib","libqpng.dylib"}) {
         fs::path p = src / "imageformats" / name;
-        if (fs::exists(p)) copyFileOverwrite(p, dstBase / "imageformats" / p.filename());
+        if (pluginExists(ctx, src, "imageformats", name)) copyFileOverwrite(p, dstBase / "imageformats" / p.filename());
     }
     std::error_code ec;
     if (fs::exists(dstBase, ec)) {
+        MachOEdits edits;
+        edits.addRpaths.push_back("@loader_path/../../Frameworks");
+        JobPool pool(plan.jobs);
         for (auto it = fs::recursive_directory_iterator(dstBase, fs::directory_options::skip_permission_denied, ec);
              it != fs::recursive_directory_iterator(); ++it) {
             if (it->is_regular_file(ec) && it->path().extension() == ".dylib") {
-                int code = 0;
-                std::string cmd = std::string("llvm-install-name-tool -add_rpath '@loader_path/../../Frameworks' ") + shellEscape(it->path().string());
-                runCommand(cmd, code);
+                pool.submit([&edits, p = it->path()] { applyMachOEdits(p, edits); });
             }
         }
+        pool.wait();
     }
 }
 
@@ -197,11 +233,10 @@ void copyMainAndPatchMachO(const DeployPlan& plan) {
         std::cerr << "Warning: failed to copy main binary: " << plan.binaryPath << " -> " << dest << "\n";
         return;
     }
-    int code = 0;
-    std::string cmd = std::string("llvm-install-name-tool -add_rpath '@executable_path/../Frameworks' ") + shellEscape(dest.string());
-    runCommand(cmd, code);
-    if (code != 0) {
-        std::cerr << "Warning: llvm-install-name-tool failed to add rpath on " << dest << "\n";
+    MachOEdits edits;
+    edits.addRpaths.push_back("@executable_path/../Frameworks");
+    if (!applyMachOEdits(dest, edits)) {
+        std::cerr << "Warning: failed to add rpath on " << dest << "\n";
     }
 }
 
@@ -14,12 +14,9 @@ std::vector<std::string> computeMissingTools(BinaryType type) {
     if (!programOnPath("qmlimportscanner")) missing.push_back("qmlimportscanner");
     if (!programOnPath("lconvert")) missing.push_back("lconvert");
 
-    if (type == BinaryType::ELF) {
-        if (!programOnPath("objdump")) missing.push_back("objdump");
-        if (!programOnPath("patchelf")) missing.push_back("patchelf");
-    } else if (type == BinaryType::PE) {
-        if (!programOnPath("x86_64-w64-mingw32-objdump")) missing.push_back("x86_64-w64-mingw32-objdump");
-    } else { // Mach-O
+    // ELF and PE need no external tool: both are read (and ELF RUNPATH written) natively, with objdump,
+    // x86_64-w64-mingw32-objdump and patchelf only as optional fallbacks.
+    if (type == BinaryType::MACHO) {
         if (!programOnPath("llvm-otool")) missing.push_back("llvm-otool");
         if (!programOnPath("llvm-install-name-tool")) missing.push_back("llvm-install-name-tool");
     }
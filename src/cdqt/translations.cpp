@@ -2,11 +2,17 @@
 
 #include <algorithm>
 #include <cctype>
-#include <sstream>
+#include <iostream>
 
+#include "cache_io.h"
 #include "fs_ops.h"
+#include "qt_index.h"
 #include "util.h"
 
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
 namespace cdqt {
 
 static std::vector<std::string> detectLanguagesFromEnv() {
@@ -39,7 +45,11 @@ static fs::path translationsOutputDir(const DeployPlan& plan) {
     return plan.outputRoot / "translations";
 }
 
-static std::vector<fs::path> listModuleCatalogsForLang(const fs::path& qtTransDir, const std::string& lang) {
+static std::vector<fs::path> listModuleCatalogsForLang(const ResolveContext& ctx, const fs::path& qtTransDir,
+                                                       const std::string& lang) {
+    if (ctx.qtIndex && qtTransDir == ctx.qtIndex->qt().qtInstallTranslations) {
+        if (auto indexed = ctx.qtIndex->catalogsFor(lang)) return std::move(*indexed);
+    }
     std::vector<fs::path> files;
     std::error_code ec;
     if (!fs::exists(qtTransDir, ec) || !fs::is_directory(qtTransDir, ec)) return files;
@@ -51,17 +61,54 @@ static std::vector<fs::path> listModuleCatalogsForLang(const fs::path& qtTransDi
             files.push_back(it->path());
         }
     }
+    // Stable input order for lconvert and the cache key.
+    std::sort(files.begin(), files.end());
     return files;
 }
 
+// Merged catalogs are cached content-addressed in <cacheDir>/translations/<key>.qm, where the key hashes
+// the lconvert binary and each input catalog's path and identity.
+static std::optional<fs::path> mergedCatalogCacheFile(const fs::path& cacheDir, const std::vector<fs::path>& catalogs) {
+    if (cacheDir.empty()) return std::nullopt;
+    auto lconvert = findProgram("lconvert");
+    if (!lconvert) return std::nullopt;
+    auto toolId = fileIdentity(*lconvert);
+    if (!toolId) return std::nullopt;
+    std::uint64_t h = fnv1a(lconvert->string());
+    h = fnv1a(toolId->mtimeNs, fnv1a(toolId->size, fnv1a(toolId->ino, h)));
+    for (const auto& c : catalogs) {
+        auto id = cacheIdentity(c);
+        if (!id) return std::nullopt;
+        h = fnv1a(std::string_view("\0", 1), fnv1a(c.string(), h));
+        h = fnv1a(id->mtimeNs, fnv1a(id->size, fnv1a(id->ino, fnv1a(id->dev, h))));
+    }
+    return cacheDir / "translations" / (hex64(h) + ".qm");
+}
+
+// Adds a freshly merged catalog to the cache through a temporary file, so readers never see a partial one.
+static void storeMergedCatalog(const fs::path& merged, const fs::path& cacheFile) {
+    fs::path tmp = cacheFile;
+#if defined(_WIN32)
+    tmp += ".tmp";
+#else
+    tmp += ".tmp." + std::to_string(::getpid());
+#endif
+    std::error_code ec;
+    if (!cloneOrCopyFile(merged, tmp)) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    fs::rename(tmp, cacheFile, ec);
+    if (ec) fs::remove(tmp, ec);
+}
+
 static bool runLconvert(const std::vector<fs::path>& inputs, const fs::path& outputQm) {
     if (inputs.empty()) return false;
-    int code = 0;
-    std::ostringstream cmd;
-    cmd << "lconvert -o " << shellEscape(outputQm.string());
-    for (const auto& in : inputs) cmd << " -i " << shellEscape(in.string());
-    runCommand(cmd.str(), code);
-    return code == 0 && fs::exists(outputQm);
+    std::vector<std::string> argv{"lconvert", "-o", outputQm.string()};
+    for (const auto& in : inputs) argv.insert(argv.end(), {"-i", in.string()});
+    const ProcessResult res = runProcess(argv);
+    if (res.exitCode != 0 && isVerbose()) std::cerr << res.err;
+    return res.exitCode == 0 && fs::exists(outputQm);
 }
 
 static void copyIfExists(const fs::path& src, const fs::path& dstDir) {
@@ -79,15 +126,27 @@ void deployTranslations(const ResolveContext& ctx, const DeployPlan& plan) {
     std::error_code ec;
     fs::path outDir = translationsOutputDir(plan);
     fs::create_directories(outDir, ec);
+    // One lconvert per language; each writes its own output files, so they run side by side.
+    JobPool pool(plan.jobs);
     for (const auto& lang : langs) {
-        auto catalogs = listModuleCatalogsForLang(qtTransDir, lang);
+        auto catalogs = listModuleCatalogsForLang(ctx, qtTransDir, lang);
         if (catalogs.empty()) continue;
-        fs::path aggregated = outDir / (std::string("qt_") + lang + ".qm");
-        bool ok = runLconvert(catalogs, aggregated);
-        if (!ok) {
-            for (const auto& c : catalogs) copyIfExists(c, outDir);
-        }
+        pool.submit([&outDir, &plan, lang, catalogs = std::move(catalogs)] {
+            fs::path aggregated = outDir / (std::string("qt_") + lang + ".qm");
+            const auto cacheFile = mergedCatalogCacheFile(plan.cacheDir, catalogs);
+            std::error_code ec;
+            if (cacheFile && fs::exists(*cacheFile, ec) && cloneOrCopyFile(*cacheFile, aggregated)) {
+                if (isVerbose()) logLine("[translations] cached ", aggregated.filename());
+                return;
+            }
+            bool ok = runLconvert(catalogs, aggregated);
+            if (ok && cacheFile) storeMergedCatalog(aggregated, *cacheFile);
+            if (!ok) {
+                for (const auto& c : catalogs) copyIfExists(c, outDir);
+            }
+        });
     }
+    pool.wait();
 }
 
 } // namespace cdqt
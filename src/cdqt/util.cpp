@@ -6,10 +6,20 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <iostream>
+#include <mutex>
 #include <system_error>
+#include <unordered_map>
 
 #if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
 #include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
 #endif
 
 namespace cdqt {
@@ -22,6 +32,12 @@ bool isVerbose() {
     return v;
 }
 
+void writeLine(const std::string& line) {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << line << '\n';
+}
+
 std::string getEnv(const char* key) {
     const char* v = std::getenv(key);
     return v ? std::string(v) : std::string();
@@ -58,47 +74,264 @@ char pathListSep() {
 #endif
 }
 
-std::string runCommand(const std::string& cmd, int& exitCode) {
-    std::array<char, 4096> buffer{};
-    std::string result;
+namespace {
+
+// Splits a byte stream into lines for a callback. Complete lines are handed out straight from the
+// caller's read buffer; only a line straddling two reads is copied into `partial_`, whose capacity is
+// reused from then on.
+class LineSplitter {
+public:
+    explicit LineSplitter(const std::function<void(std::string_view)>& onLine) : onLine_(onLine) {}
+
+    void feed(const char* data, size_t n) {
+        std::string_view chunk(data, n);
+        size_t nl;
+        while ((nl = chunk.find('\n')) != std::string_view::npos) {
+            if (partial_.empty()) {
+                emit(chunk.substr(0, nl));
+            } else {
+                partial_.append(chunk.data(), nl);
+                emit(partial_);
+                partial_.clear();
+            }
+            chunk.remove_prefix(nl + 1);
+        }
+        partial_.append(chunk.data(), chunk.size());
+    }
+
+    void finish() {
+        if (!partial_.empty()) emit(partial_);
+        partial_.clear();
+    }
+
+private:
+    void emit(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        onLine_(line);
+    }
+
+    const std::function<void(std::string_view)>& onLine_;
+    std::string partial_;
+};
+
+} // namespace
+
+#if defined(_WIN32)
+
+static int closePipe(FILE* pipe) {
+    return pclose(pipe);
+}
+
+// No posix_spawn: quote for cmd.exe and go through the shell; stderr is not captured.
+ProcessResult runProcess(const std::vector<std::string>& argv, const std::function<void(std::string_view)>& onStdoutLine) {
+    ProcessResult r;
+    if (argv.empty()) return r;
+    std::string cmd;
+    for (const auto& a : argv) {
+        if (!cmd.empty()) cmd.push_back(' ');
+        cmd.push_back('"');
+        for (char c : a) {
+            if (c == '"') cmd.push_back('\\');
+            cmd.push_back(c);
+        }
+        cmd.push_back('"');
+    }
     FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
-        exitCode = -1;
-        return {};
+    if (!pipe) return r;
+    std::array<char, 16384> buffer{};
+    LineSplitter lines(onStdoutLine);
+    size_t n = 0;
+    while ((n = std::fread(buffer.data(), 1, buffer.size(), pipe)) > 0) {
+        if (onStdoutLine) lines.feed(buffer.data(), n);
+        else r.out.append(buffer.data(), n);
+    }
+    if (onStdoutLine) lines.finish();
+    r.exitCode = closePipe(pipe);
+    return r;
+}
+
+#else
+
+ProcessResult runProcess(const std::vector<std::string>& argv, const std::function<void(std::string_view)>& onStdoutLine) {
+    ProcessResult r;
+    if (argv.empty()) return r;
+    const auto program = findProgram(argv[0]);
+    if (!program) return r;
+    const std::string programPath = program->string();
+
+    // Pipes are close-on-exec so that children spawned concurrently from other threads do not inherit
+    // them (and keep them open past this child's exit); dup2 clears the flag on the child's 1 and 2.
+    // The lock closes the gap between pipe() and fcntl() on platforms without pipe2.
+    static std::mutex spawnMutex;
+    std::unique_lock<std::mutex> spawnLock(spawnMutex);
+    int outPipe[2];
+    int errPipe[2];
+    if (pipe(outPipe) != 0) return r;
+    if (pipe(errPipe) != 0) {
+        close(outPipe[0]);
+        close(outPipe[1]);
+        return r;
     }
-    while (fgets(buffer.data(), static_cast<int>(buffer.size()), pipe) != nullptr) {
-        result.append(buffer.data());
+    for (int fd : {outPipe[0], outPipe[1], errPipe[0], errPipe[1]}) fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    std::vector<char*> args;
+    args.reserve(argv.size() + 1);
+    for (const auto& a : argv) args.push_back(const_cast<char*>(a.c_str()));
+    args.push_back(nullptr);
+
+    pid_t pid = 0;
+    const int rc = posix_spawn(&pid, programPath.c_str(), &actions, nullptr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(outPipe[1]);
+    close(errPipe[1]);
+    spawnLock.unlock();
+    if (rc != 0) {
+        close(outPipe[0]);
+        close(errPipe[0]);
+        return r;
     }
-    exitCode = pclose(pipe);
-#if !defined(_WIN32)
-    if (exitCode != -1) {
-        if (WIFEXITED(exitCode)) {
-            exitCode = WEXITSTATUS(exitCode);
+
+    // Drain both pipes together so a child filling one of them can never block on the other.
+    LineSplitter lines(onStdoutLine);
+    std::array<char, 16384> buffer{};
+    pollfd fds[2] = {{outPipe[0], POLLIN, 0}, {errPipe[0], POLLIN, 0}};
+    int open = 2;
+    while (open > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) continue;
+            const ssize_t n = read(fds[i].fd, buffer.data(), buffer.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                --open;
+                continue;
+            }
+            if (i == 1) r.err.append(buffer.data(), static_cast<size_t>(n));
+            else if (onStdoutLine) lines.feed(buffer.data(), static_cast<size_t>(n));
+            else r.out.append(buffer.data(), static_cast<size_t>(n));
         }
     }
+    for (auto& f : fds) if (f.fd >= 0) close(f.fd);
+    if (onStdoutLine) lines.finish();
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return r;
+    }
+    if (WIFEXITED(status)) r.exitCode = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status)) r.exitCode = 128 + WTERMSIG(status);
+    return r;
+}
+
 #endif
-    return result;
+
+JobPool::JobPool(unsigned jobs) {
+    if (jobs == 0) jobs = defaultJobCount();
+    workers_.reserve(jobs);
+    for (unsigned i = 0; i < jobs; ++i) workers_.emplace_back([this]{ workerLoop(); });
 }
 
-std::string shellEscape(const std::string& s) {
-    std::string out;
-    out.reserve(s.size() + 2);
-    out.push_back('\'');
-    for (char c : s) {
-        if (c == '\'') {
-            out += "'\\''";
-        } else {
-            out.push_back(c);
-        }
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
     }
-    out.push_back('\'');
-    return out;
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void JobPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void JobPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]{ return queue_.empty() && running_ == 0; });
+}
+
+void JobPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this]{ return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return; // stopping, and everything queued has run
+        std::function<void()> job = std::move(queue_.front());
+        queue_.pop_front();
+        ++running_;
+        lock.unlock();
+        job();
+        lock.lock();
+        --running_;
+        if (queue_.empty() && running_ == 0) idle_.notify_all();
+    }
+}
+
+unsigned defaultJobCount() {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+static bool isExecutableFile(const fs::path& p) {
+    std::error_code ec;
+    if (!fs::is_regular_file(p, ec)) return false;
+#if defined(_WIN32)
+    return true;
+#else
+    return access(p.c_str(), X_OK) == 0;
+#endif
+}
+
+std::optional<fs::path> findProgram(const std::string& name) {
+    if (name.empty()) return std::nullopt;
+    if (name.find('/') != std::string::npos || name.find('\\') != std::string::npos) {
+        if (isExecutableFile(name)) return fs::path(name);
+        return std::nullopt;
+    }
+
+    // PATH is split once and lookups are memoized per name; both are dropped when PATH changes
+    // (ensureEnvForResolution prepends the Qt bin directory for PE deploys).
+    static std::mutex mutex;
+    static std::string cachedPath;
+    static std::vector<std::string> dirs;
+    static std::unordered_map<std::string, std::optional<fs::path>> found;
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string path = getEnv("PATH");
+    if (dirs.empty() || path != cachedPath) {
+        cachedPath = path;
+        dirs = splitPaths(path, pathListSep());
+        found.clear();
+    }
+    auto it = found.find(name);
+    if (it != found.end()) return it->second;
+
+    std::optional<fs::path> hit;
+    for (const auto& dir : dirs) {
+        fs::path cand = fs::path(dir) / name;
+        if (isExecutableFile(cand)) { hit = cand; break; }
+#if defined(_WIN32)
+        cand += ".exe";
+        if (isExecutableFile(cand)) { hit = cand; break; }
+#endif
+    }
+    found.emplace(name, hit);
+    return hit;
 }
 
 bool programOnPath(const std::string& name) {
-    int code = 0;
-    runCommand(std::string("command -v ") + name + " >/dev/null 2>&1", code);
-    return code == 0;
+    return findProgram(name).has_value();
 }
 
 bool fileExistsExecutable(const fs::path& p) {
@@ -109,11 +342,69 @@ bool fileExistsExecutable(const fs::path& p) {
     return fs::is_regular_file(st) || fs::is_symlink(st);
 }
 
+bool isNixStorePath(const fs::path& p) {
+    static const std::string storeDir = [] {
+        std::string d = getEnv("NIX_STORE_DIR");
+        if (d.empty()) d = "/nix/store";
+        while (d.size() > 1 && d.back() == '/') d.pop_back();
+        return d + "/";
+    }();
+    const std::string& s = p.native();
+    return s.size() > storeDir.size() && s.compare(0, storeDir.size(), storeDir) == 0;
+}
+
+fs::path canonicalPath(const fs::path& p) {
+    const bool immutable = isNixStorePath(p);
+    static std::mutex mutex;
+    static std::unordered_map<std::string, fs::path> memo;
+    if (immutable) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = memo.find(p.native());
+        if (it != memo.end()) return it->second;
+    }
+    std::error_code ec;
+    fs::path c = fs::weakly_canonical(p, ec);
+    if (ec) c = p;
+    if (immutable) {
+        std::lock_guard<std::mutex> lock(mutex);
+        memo.emplace(p.native(), c);
+    }
+    return c;
+}
+
+std::string_view trimWhitespace(std::string_view s) {
+    auto ws = [](char c){ return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+    while (!s.empty() && ws(s.front())) s.remove_prefix(1);
+    while (!s.empty() && ws(s.back())) s.remove_suffix(1);
+    return s;
+}
+
 bool endsWith(const std::string& s, const std::string& suffix) {
     if (suffix.size() > s.size()) return false;
     return std::equal(suffix.rbegin(), suffix.rend(), s.rbegin());
 }
 
+std::uint64_t fnv1a(std::string_view data, std::uint64_t seed) {
+    std::uint64_t h = seed;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+std::uint64_t fnv1a(std::uint64_t v, std::uint64_t seed) {
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) bytes[i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+    return fnv1a(std::string_view(bytes, sizeof(bytes)), seed);
+}
+
+std::string hex64(std::uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
 } // namespace cdqt
 
 
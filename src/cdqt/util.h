@@ -1,7 +1,20 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace cdqt {
@@ -10,20 +23,101 @@ namespace fs = std::filesystem;
 
 bool isVerbose();
 
+// Writes `line` and a newline to stdout as one locked write, so lines logged by concurrent jobs never
+// interleave.
+void writeLine(const std::string& line);
+// Streams `parts` into one line and writes it with writeLine.
+template <class... T>
+void logLine(const T&... parts) {
+    std::ostringstream os;
+    (os << ... << parts);
+    writeLine(os.str());
+}
+
 std::string getEnv(const char* key);
 void setEnv(const std::string& key, const std::string& value);
 
 std::vector<std::string> splitPaths(const std::string& s, char sep);
 char pathListSep();
 
-std::string runCommand(const std::string& cmd, int& exitCode);
-std::string shellEscape(const std::string& s);
+struct ProcessResult {
+    int exitCode = -1; // -1 if the program could not be started; 128 + signal if it was killed
+    std::string out;   // stdout, unless it was streamed to onStdoutLine
+    std::string err;
+};
+
+// Runs argv[0] (resolved with findProgram) directly, without a shell, capturing stdout and stderr on separate
+// pipes. With onStdoutLine set, stdout is streamed to it one line at a time (without the terminator)
+// instead of being collected; each view points into a reused read buffer and is only valid during
+// the call.
+ProcessResult runProcess(const std::vector<std::string>& argv,
+                         const std::function<void(std::string_view)>& onStdoutLine = {});
+
+// Runs jobs on a fixed number of worker threads, so that up to N external tools (or native edits)
+// are in flight at once. The destructor waits for every submitted job.
+class JobPool {
+public:
+    explicit JobPool(unsigned jobs);
+    ~JobPool();
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    template <class F>
+    std::future<std::invoke_result_t<F>> submit(F&& f) {
+        using R = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        enqueue([task]{ (*task)(); });
+        return result;
+    }
+
+    // Blocks until every job submitted so far has finished.
+    void wait();
+
+private:
+    void enqueue(std::function<void()> job);
+    void workerLoop();
 
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> queue_;
+    std::size_t running_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// Worker count for --jobs 0 (the default): the number of hardware threads.
+unsigned defaultJobCount();
+
+// Absolute path of an executable `name` on PATH (or `name` itself if it contains a slash and is
+// executable). Memoized per name for the current PATH value.
+std::optional<fs::path> findProgram(const std::string& name);
 bool programOnPath(const std::string& name);
 bool fileExistsExecutable(const fs::path& p);
 
+// Paths inside the Nix store (NIX_STORE_DIR, default /nix/store) never change once created, so the path
+// itself serves as a content identity: anything derived from such a file can be cached and reused
+// without stat or hash checks.
+bool isNixStorePath(const fs::path& p);
+
+// fs::weakly_canonical that returns `p` unchanged on error. Results for Nix store paths are memoized
+// for the whole process.
+fs::path canonicalPath(const fs::path& p);
+
+// Strips leading/trailing spaces, tabs, CR and LF.
+std::string_view trimWhitespace(std::string_view s);
+
 bool endsWith(const std::string& s, const std::string& suffix);
 
+// 64-bit FNV-1a. Pass a previous result as `seed` to hash several pieces as one stream.
+constexpr std::uint64_t kFnv1aOffset = 0xcbf29ce484222325ULL;
+std::uint64_t fnv1a(std::string_view data, std::uint64_t seed = kFnv1aOffset);
+// Hashes the 8 little-endian bytes of `v`.
+std::uint64_t fnv1a(std::uint64_t v, std::uint64_t seed);
+// `v` as 16 lowercase hex digits, for naming cache files.
+std::string hex64(std::uint64_t v);
+
 } // namespace cdqt
 
 
@@ -3,8 +3,11 @@
 
 #include "cdqt/args.h"
 #include "cdqt/binary_detect.h"
+#include "cdqt/cache_io.h"
 #include "cdqt/common.h"
 #include "cdqt/deploy.h"
+#include "cdqt/qt_index.h"
+#include "cdqt/qt_paths.h"
 #include "cdqt/tools.h"
 
 int main(int argc, char** argv) {
@@ -15,6 +18,28 @@ int main(int argc, char** argv) {
         }
         cdqt::Args args = *maybeArgs;
 
+        if (args.indexQt) {
+            cdqt::fs::path cacheDir = args.cacheDir.empty() ? cdqt::defaultCacheDir() : args.cacheDir;
+            if (args.noCache || cacheDir.empty()) {
+                std::cerr << "--index-qt needs a cache directory (--cache-dir)" << "\n";
+                return 2;
+            }
+            const cdqt::QtPathsInfo& qt = cdqt::queryQtPaths();
+            if (qt.qtInstallLibs.empty()) {
+                std::cerr << "Failed to query Qt installation paths" << "\n";
+                return 2;
+            }
+            auto summary = cdqt::buildQtIndex(cacheDir, qt, args.jobs);
+            if (!summary) {
+                std::cerr << "Failed to write Qt index in " << cacheDir << "\n";
+                return 1;
+            }
+            std::cout << "Indexed Qt at " << qt.qtInstallPrefix << ": " << summary->libraries << " binaries, "
+                      << summary->plugins << " plugins, " << summary->qmlModules << " QML modules, "
+                      << summary->catalogs << " translation catalogs -> " << summary->file << "\n";
+            return 0;
+        }
+
         if (!cdqt::fs::exists(args.binaryPath)) {
             std::cerr << "Binary does not exist: " << args.binaryPath << "\n";
             return 2;
@@ -33,7 +58,9 @@ int main(int argc, char** argv) {
         }
 
         cdqt::fs::path normalizedOut = cdqt::ensurePlatformOutputRoot(*maybeType, args.outDir, args.binaryPath);
-        cdqt::DeployPlan plan{*maybeType, args.binaryPath, normalizedOut, args.qmlRoots, args.languages, args.overlays};
+        cdqt::fs::path cacheDir = args.noCache ? cdqt::fs::path() : (args.cacheDir.empty() ? cdqt::defaultCacheDir() : args.cacheDir);
+        cdqt::DeployPlan plan{*maybeType, args.binaryPath, normalizedOut, args.qmlRoots, args.languages, args.overlays,
+                              args.jobs, cacheDir};
         std::cout << "Detected: " << cdqt::toString(plan.type) << "\n";
 
         // Verify external tool availability for this platform